@@ -0,0 +1,116 @@
+// Per-call overhead of the C interface
+
+#include <chrono>
+#include <vector>
+
+#include "capi.h"
+#include "assembly.h"
+#include "materials.h"
+#include "constants.h"
+#include "log.h"
+
+using namespace std;
+using namespace gblsim;
+using namespace unilog;
+
+int main(int argc, char* argv[]) {
+
+  /*
+   * DATURA telescope with six MIMOSA26 planes with 150mm spacing and 3.24um resolution, and a
+   * DUT as unknown scatterer between the third and fourth plane. The track resolution at all
+   * planes is evaluated repeatedly with the telescope class directly and through the C
+   * interface, and the mean time per evaluation is compared. Batches of DUT positions evaluate
+   * only the DUT, distributed over the thread pool.
+   */
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+  int iterations = 2000;
+
+  for (int i = 1; i < argc; i++) {
+    // Setting verbosity:
+    if (std::string(argv[i]) == "-v") {
+      Log::ReportingLevel() = Log::FromString(std::string(argv[++i]));
+      continue;
+    }
+    // Number of evaluations per method:
+    if (std::string(argv[i]) == "-n") {
+      iterations = std::stoi(std::string(argv[++i]));
+      continue;
+    }
+  }
+
+  double MIM26 = 55e-3 / X0_Si + 50e-3 / X0_Kapton;
+  double RES = 3.24e-3;
+  double BEAM = 5.0;
+  double DUT_DIST = 20;
+
+  std::vector<int> types;
+  std::vector<double> z, material, resolution, size;
+  for(int p = 0; p < 6; p++) {
+    types.push_back(GBLSIM_ACTIVE);
+    z.push_back(150.*p + (p > 2 ? 2*DUT_DIST - 150. : 0.));
+    material.push_back(MIM26);
+    resolution.push_back(RES);
+    size.push_back(0.);
+  }
+  types.insert(types.begin() + 3, GBLSIM_UNKNOWN);
+  z.insert(z.begin() + 3, z.at(2) + DUT_DIST);
+  material.insert(material.begin() + 3, 0.);
+  resolution.insert(resolution.begin() + 3, 0.);
+  size.insert(size.begin() + 3, 1.);
+
+  // The fits themselves log every geometry:
+  TLogLevel level = Log::ReportingLevel();
+  Log::ReportingLevel() = logWARNING;
+
+  // Reference: building the planes and fitting with the telescope class directly
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  double direct_result = 0;
+  for(int i = 0; i < iterations; i++) {
+    std::vector<plane> planes;
+    for(size_t p = 0; p < types.size(); p++) {
+      if(types[p] == GBLSIM_ACTIVE) planes.push_back(plane::active(z[p], material[p], resolution[p]));
+      else planes.push_back(plane::unknown(z[p], size[p]));
+    }
+    telescope tel(planes, BEAM);
+    for(size_t p = 0; p < planes.size(); p++) {
+      double r = tel.getResolutionXY(p).first;
+      if(p == 3) direct_result = r;
+    }
+  }
+  double direct = std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+  // Handle evaluated after updating the DUT position in place:
+  gblsim_telescope* handle = gblsim_create(types.size(), types.data(), z.data(), material.data(), resolution.data(),
+                                           resolution.data(), size.data(), BEAM, X0_Air);
+  if(!handle) return 1;
+  std::vector<double> results(2*types.size());
+  start = std::chrono::steady_clock::now();
+  for(int i = 0; i < iterations; i++) {
+    gblsim_set_position(handle, 3, z[3]);
+    gblsim_evaluate(handle, results.data(), nullptr);
+  }
+  double single = std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+  double single_result = results.at(2*3);
+
+  // Batch of DUT positions, evaluated in parallel:
+  std::vector<double> positions(iterations, z[3]);
+  std::vector<double> output(2*iterations);
+  start = std::chrono::steady_clock::now();
+  int status = gblsim_evaluate_batch(handle, GBLSIM_POSITION, 3, positions.size(), positions.data(),
+                                     GBLSIM_TRACK_RESOLUTION, 3, output.data());
+  double batch = std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+  gblsim_destroy(handle);
+  Log::ReportingLevel() = level;
+
+  if(status != GBLSIM_OK) {
+    LOG(logERROR) << "Batch evaluation failed: " << gblsim_status_string(status);
+    return 1;
+  }
+
+  LOG(logRESULT) << "Direct:    " << direct << "us per evaluation, resolution " << direct_result << "um";
+  LOG(logRESULT) << "C handle:  " << single << "us per evaluation, resolution " << single_result << "um, overhead "
+                 << (single - direct) << "us";
+  LOG(logRESULT) << "C batch:   " << batch << "us per variant, resolution " << output.at(0) << "um";
+  return 0;
+}
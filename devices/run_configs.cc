@@ -0,0 +1,91 @@
+// Evaluation of telescope setups from configuration files
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+#include "assembly.h"
+#include "config.h"
+#include "threadpool.h"
+#include "log.h"
+
+using namespace std;
+using namespace gblsim;
+using namespace unilog;
+
+int main(int argc, char* argv[]) {
+
+  /*
+   * Reads telescope setups from any number of configuration files (see config.h for the format,
+   * configs/ for examples) instead of one compiled executable per setup. All setups are evaluated
+   * in parallel on the shared thread pool and their results are written in the order of the
+   * files as tab-separated lines: setup name, output type, plane index and result. With a cache
+   * directory, geometries evaluated before by any process are not fitted again.
+   */
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+  // Messages are logged from the worker threads:
+  SetLogOutput::Asynchronous() = true;
+  std::vector<std::string> files;
+  std::string outfile;
+  std::string cachedir;
+
+  for (int i = 1; i < argc; i++) {
+    // Setting verbosity:
+    if (std::string(argv[i]) == "-v") {
+      Log::ReportingLevel() = Log::FromString(std::string(argv[++i]));
+      continue;
+    }
+    // Output file, standard output by default:
+    if (std::string(argv[i]) == "-o") {
+      outfile = std::string(argv[++i]);
+      continue;
+    }
+    // Directory of the persistent result cache:
+    if (std::string(argv[i]) == "-c") {
+      cachedir = std::string(argv[++i]);
+      continue;
+    }
+    files.push_back(std::string(argv[i]));
+  }
+
+  if(files.empty()) {
+    LOG(logERROR) << "Usage: " << argv[0] << " [-v LEVEL] [-o FILE] [-c CACHEDIR] CONFIG...";
+    return 1;
+  }
+
+  // Variables defined in one file remain available in the following files:
+  configreader reader;
+  std::vector<setup> setups;
+  bool valid = true;
+  for(const auto& f : files) valid &= reader.read(f, setups);
+
+  std::unique_ptr<resultcache> cache;
+  if(!cachedir.empty()) cache.reset(new resultcache(cachedir));
+
+  std::vector<std::vector<std::string>> results(setups.size());
+  threadpool::global().parallel_for(setups.size(), [&setups, &results, &cache](size_t s) {
+      results.at(s) = run(setups.at(s), cache.get());
+    });
+
+  std::ofstream file;
+  if(!outfile.empty()) {
+    file.open(outfile.c_str());
+    if(!file) {
+      LOG(logERROR) << "Cannot write to " << outfile;
+      return 1;
+    }
+  }
+  std::ostream& out = (outfile.empty() ? std::cout : file);
+  for(const auto& lines : results) {
+    for(const auto& line : lines) out << line << std::endl;
+  }
+
+  LOG(logINFO) << "Evaluated " << setups.size() << " setups from " << files.size() << " files";
+  if(cache) {
+    cachestatistics stats = cache->getStatistics();
+    LOG(logINFO) << "Cache: " << stats.hits << " hits, " << stats.misses << " misses, " << stats.stores << " stored, "
+                 << stats.evictions << " evicted";
+  }
+  return (valid ? 0 : 1);
+}
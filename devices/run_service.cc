@@ -0,0 +1,66 @@
+// Query service for telescope resolutions with warm caches
+
+#include <memory>
+#include <unistd.h>
+
+#include "cache.h"
+#include "service.h"
+#include "log.h"
+
+using namespace std;
+using namespace gblsim;
+using namespace unilog;
+
+int main(int argc, char* argv[]) {
+
+  /*
+   * Long-running service answering line-delimited JSON requests (see service.h for the format)
+   * on standard input and output, or on a Unix domain socket for any number of clients. Fits
+   * are kept in memory, so repeated queries for a geometry, e.g. from an interactive scan or a
+   * web frontend, are answered without fitting again. Requests are handled concurrently and the
+   * latency percentiles are reported at the end and on the "statistics" query.
+   */
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+  // Messages are logged from the worker threads:
+  SetLogOutput::Asynchronous() = true;
+  std::string socketpath;
+  std::string cachedir;
+  size_t capacity = 4096;
+
+  for (int i = 1; i < argc; i++) {
+    // Setting verbosity:
+    if (std::string(argv[i]) == "-v") {
+      Log::ReportingLevel() = Log::FromString(std::string(argv[++i]));
+      continue;
+    }
+    // Unix domain socket to listen on, standard input and output by default:
+    if (std::string(argv[i]) == "-s") {
+      socketpath = std::string(argv[++i]);
+      continue;
+    }
+    // Directory of the persistent result cache:
+    if (std::string(argv[i]) == "-c") {
+      cachedir = std::string(argv[++i]);
+      continue;
+    }
+    // Number of geometries kept in memory:
+    if (std::string(argv[i]) == "-n") {
+      capacity = std::stoul(argv[++i]);
+      continue;
+    }
+    LOG(logERROR) << "Usage: " << argv[0] << " [-v LEVEL] [-s SOCKET] [-c CACHEDIR] [-n CAPACITY]";
+    return 1;
+  }
+
+  std::unique_ptr<resultcache> cache;
+  if(!cachedir.empty()) cache.reset(new resultcache(cachedir));
+  service server(capacity, cache.get());
+
+  if(!socketpath.empty()) return server.listen(socketpath) ? 0 : 1;
+
+  server.serve(STDIN_FILENO, STDOUT_FILENO);
+  LOG(logRESULT) << "Latency p50 " << server.getLatency(0.5) << " ms, p90 " << server.getLatency(0.9)
+                 << " ms, p99 " << server.getLatency(0.99) << " ms, max " << server.getLatency(1.) << " ms";
+  return 0;
+}
@@ -0,0 +1,74 @@
+// Scaling of the resolution calculation with the number of planes
+
+#include <chrono>
+
+#include "assembly.h"
+#include "streaming.h"
+#include "propagate.h"
+#include "materials.h"
+#include "constants.h"
+#include "log.h"
+
+using namespace std;
+using namespace gblsim;
+using namespace unilog;
+
+int main(int argc, char* argv[]) {
+
+  /*
+   * Layered tracker with silicon planes of 300um thickness every 10mm and 10um resolution,
+   * from 6 to 10000 planes. The resolution at the first, central and last plane is calculated
+   * with the streaming filter and, up to 100 planes by default, with the full telescope.
+   */
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+  int max_telescope = 100;
+
+  for (int i = 1; i < argc; i++) {
+    // Setting verbosity:
+    if (std::string(argv[i]) == "-v") {
+      Log::ReportingLevel() = Log::FromString(std::string(argv[++i]));
+      continue;
+    }
+    // Largest geometry evaluated with the full telescope:
+    if (std::string(argv[i]) == "-t") {
+      max_telescope = std::stoi(std::string(argv[++i]));
+      continue;
+    }
+  }
+
+  // Beam energy 120 GeV hadrons at the SPS:
+  double BEAM = 120.0;
+
+  for(int n : {6, 10, 30, 100, 300, 1000, 3000, 10000}) {
+    std::vector<plane> planes;
+    for(int i = 0; i < n; i++) {
+      planes.push_back(plane(10.*i, 0.3 / X0_Si, true, 10e-3));
+    }
+    std::vector<int> selected = {0, n/2, n-1};
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::pair<double,double>> resolution = getResolutionsXY(planes, selected, BEAM);
+    std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+    double streaming = std::chrono::duration<double,std::micro>(stop - start).count();
+    LOG(logRESULT) << n << " planes, streaming: " << streaming << "us (" << streaming/n << "us per plane), resolution "
+                   << resolution.at(0).first << "um / " << resolution.at(1).first << "um / " << resolution.at(2).first << "um";
+
+    if(n > max_telescope) continue;
+
+    // Full telescope with all points stored:
+    TLogLevel level = Log::ReportingLevel();
+    Log::ReportingLevel() = std::min(level, logWARNING);
+    start = std::chrono::steady_clock::now();
+    telescope mytel(planes, BEAM);
+    std::vector<double> full;
+    for(auto s : selected) full.push_back(mytel.getResolution(s));
+    stop = std::chrono::steady_clock::now();
+    Log::ReportingLevel() = level;
+    double fit = std::chrono::duration<double,std::micro>(stop - start).count();
+    LOG(logRESULT) << n << " planes, telescope: " << fit << "us (" << fit/n << "us per plane, "
+                   << mytel.getNumberOfPoints() << " points), resolution "
+                   << full.at(0) << "um / " << full.at(1) << "um / " << full.at(2) << "um";
+  }
+  return 0;
+}
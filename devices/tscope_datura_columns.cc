@@ -0,0 +1,124 @@
+// Large design scan for the DATURA telescope written to a columnar result file
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "assembly.h"
+#include "trackmodel.h"
+#include "results.h"
+#include "pipeline.h"
+#include "threadpool.h"
+#include "materials.h"
+#include "constants.h"
+#include "log.h"
+
+using namespace std;
+using namespace gblsim;
+using namespace unilog;
+
+int main(int argc, char* argv[]) {
+
+  /*
+   * Scan of plane distance, distance of the arms to the DUT and DUT material for the DATURA
+   * telescope at the DESY TB21 beam line. Every point is one record with the parameters and the
+   * track resolution at the DUT. The output format follows the file extension: .csv or .jsonl for
+   * text, binary columnar otherwise. Records are written by the output pipeline while the scan
+   * is running, optionally into a second text file. Columnar files are mapped back to find the
+   * best layout.
+   */
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+  std::string filename = "datura-scan.col";
+  std::string textfile;
+  int steps = 40;
+  bool compress = false;
+
+  for (int i = 1; i < argc; i++) {
+    // Setting verbosity:
+    if (std::string(argv[i]) == "-v") {
+      Log::ReportingLevel() = Log::FromString(std::string(argv[++i]));
+      continue;
+    }
+    // Output file:
+    if (std::string(argv[i]) == "-f") {
+      filename = std::string(argv[++i]);
+      continue;
+    }
+    // Additional text output file:
+    if (std::string(argv[i]) == "-t") {
+      textfile = std::string(argv[++i]);
+      continue;
+    }
+    // Number of steps per scan parameter:
+    if (std::string(argv[i]) == "-n") {
+      steps = std::stoi(std::string(argv[++i]));
+      continue;
+    }
+    // Compress columnar output:
+    if (std::string(argv[i]) == "-z") {
+      compress = true;
+      continue;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Preparation of the telescope and beam properties:
+
+  // MIMOSA26 telescope planes consist of 50um silicon plus 2x25um Kapton foil only:
+  double MIM26 = 55e-3 / X0_Si + 50e-3 / X0_Kapton;
+  // The intrinsic resolution has been measured to be around 3.24um:
+  double RES = 3.24e-3;
+  // Beam energy 5 GeV electrons/positrons at DESY:
+  double BEAM = 5.0;
+
+  //----------------------------------------------------------------------------
+  // Scan, one slice of plane distances per task, records are written while scanning:
+
+  std::vector<std::string> columns = {"dist", "dut_dist", "dut_x0", "resolution"};
+  pipeline output(columns);
+  bool columnar = output.addSink(openSink(filename, columns, compress))
+    && filename.find(".csv") == std::string::npos && filename.find(".jsonl") == std::string::npos;
+  if(!textfile.empty()) output.addSink(openSink(textfile, columns));
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  threadpool::global().parallel_for(steps, [&](size_t s) {
+      double dist = 20 + 130.*s/steps;
+      for(int d = 0; d < steps; d++) {
+        double dut_dist = 10 + 90.*d/steps;
+        for(int m = 0; m < steps; m++) {
+          // DUT material from 0.1% to 10% radiation length:
+          double dut_x0 = 1e-3*std::pow(100., static_cast<double>(m)/steps);
+          std::vector<layer<double>> layers;
+          for(int i = 0; i < 6; i++) {
+            layer<double> l(plane(i*dist + (i > 2 ? 2*dut_dist - dist : 0), MIM26, true, RES));
+            layers.push_back(l);
+          }
+          layers.push_back(layer<double>(plane(2*dist + dut_dist, dut_x0, false)));
+          trackmodel<double> model(layers, BEAM);
+          output.push({dist, dut_dist, dut_x0, std::sqrt(model.getVariance(6))*1e3});
+        }
+      }
+    });
+  std::chrono::steady_clock::time_point scanned = std::chrono::steady_clock::now();
+  bool complete = output.close();
+  std::chrono::steady_clock::time_point written = std::chrono::steady_clock::now();
+  LOG(logRESULT) << "Scanned " << steps*steps*steps << " points in " << std::chrono::duration<double>(scanned - start).count()
+                 << "s, remaining output written in " << std::chrono::duration<double>(written - scanned).count() << "s";
+
+  if(!complete) return 1;
+
+  //----------------------------------------------------------------------------
+  // Read back the columnar file:
+
+  if(!columnar) return 0;
+  columnreader in(filename);
+  if(!in.good()) return 1;
+  std::vector<double> resolution = in.get(in.getColumn("resolution"));
+  if(resolution.empty()) return 1;
+  size_t best = std::min_element(resolution.begin(), resolution.end()) - resolution.begin();
+  LOG(logRESULT) << "Best of " << in.getRecords() << " records: plane distance " << in.get(in.getColumn("dist")).at(best)
+                 << "mm, DUT distance " << in.get(in.getColumn("dut_dist")).at(best) << "mm, DUT x/X0 "
+                 << in.get(in.getColumn("dut_x0")).at(best) << ", resolution " << resolution.at(best) << "um";
+  return 0;
+}
@@ -0,0 +1,112 @@
+// Material imaging of a DUT from measured kink widths
+
+#include "TCanvas.h"
+#include "TH2D.h"
+#include "TFile.h"
+
+#include "assembly.h"
+#include "imaging.h"
+#include "propagate.h"
+#include "materials.h"
+#include "constants.h"
+#include "log.h"
+
+using namespace std;
+using namespace gblsim;
+using namespace unilog;
+
+int main(int argc, char* argv[]) {
+
+  /*
+   * Material imaging with the DATURA telescope at the DESY TB21 beam line
+   * Six MIMOSA26 planes with 20mm spacing, intrinsic sensor resolution 3.24um
+   * DUT as unknown scatterer: a map of kink widths is converted into an x/X0 map
+   */
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+
+  for (int i = 1; i < argc; i++) {
+    // Setting verbosity:
+    if (std::string(argv[i]) == "-v") {
+      Log::ReportingLevel() = Log::FromString(std::string(argv[++i]));
+      continue;
+    }
+  }
+
+  TFile * out = TFile::Open("datura-imaging.root","RECREATE");
+  gDirectory->pwd();
+
+  //----------------------------------------------------------------------------
+  // Preparation of the telescope and beam properties:
+
+  // MIMOSA26 telescope planes consist of 50um silicon plus 2x25um Kapton foil only:
+  double MIM26 = 55e-3 / X0_Si + 50e-3 / X0_Kapton;
+  // The intrinsic resolution has been measured to be around 3.24um:
+  double RES = 3.24e-3;
+
+  // Distance between telescope planes and of the DUT to the telescope arms in mm:
+  double DIST = 20;
+  double DUT_DIST = 20;
+
+  // Thickness of the DUT in mm:
+  double DUT_SIZE = 0.5;
+
+  // Beam energy 5 GeV electrons/positrons at DESY:
+  double BEAM = 5.0;
+
+  std::vector<plane> planes;
+  double position = 0;
+  for(int i = 0; i < 3; i++) {
+    planes.push_back(plane(position,MIM26,true,RES));
+    position += DIST;
+  }
+  position = 2*DIST + 2*DUT_DIST;
+  for(int i = 0; i < 3; i++) {
+    planes.push_back(plane(position,MIM26,true,RES));
+    position += DIST;
+  }
+  planes.push_back(plane::unknown(2*DIST + DUT_DIST, DUT_SIZE));
+
+  telescope mytel(planes, BEAM);
+
+  // Prepare the lookup table for the DUT (plane 3) up to 10% X0 once:
+  kinkimager imager(mytel, 3, 0.1);
+
+  //----------------------------------------------------------------------------
+  // Measured kink widths: here a 400x200 pixel map with a silicon sensor and a copper frame,
+  // with 2% statistical uncertainty per pixel
+
+  map2d widths(400, 200, 0., -10., -5., 0.05, 0.05);
+  map2d errors(400, 200);
+  for(size_t iy = 0; iy < widths.ny; iy++) {
+    for(size_t ix = 0; ix < widths.nx; ix++) {
+      bool frame = (ix < 20 || ix >= 380 || iy < 20 || iy >= 180);
+      double x0 = 0.3 / X0_Si + (frame ? 0.2 / X0_Cu : 0.);
+      widths(ix, iy) = imager.getKinkWidth(x0);
+      errors(ix, iy) = 0.02 * widths(ix, iy);
+    }
+  }
+
+  map2d material, material_errors;
+  imager.invert(widths, errors, material, material_errors);
+
+  TH2D *hMaterial = new TH2D("material","DUT material budget;x [mm];y [mm];x/X_{0}",
+                             material.nx, material.xmin, material.xmin + material.nx*material.pitch_x,
+                             material.ny, material.ymin, material.ymin + material.ny*material.pitch_y);
+  for(size_t iy = 0; iy < material.ny; iy++) {
+    for(size_t ix = 0; ix < material.nx; ix++) {
+      hMaterial->SetBinContent(ix+1, iy+1, material(ix, iy));
+      hMaterial->SetBinError(ix+1, iy+1, material_errors(ix, iy));
+    }
+  }
+  LOG(logRESULT) << "DUT material budget at sensor centre: " << material(200, 100) << " +- " << material_errors(200, 100) << " x/X0";
+
+  TCanvas *c1 = new TCanvas("c1","material",700,700);
+  c1->cd();
+  hMaterial->Draw("colz");
+  c1->Write();
+
+  // Write result to file
+  out->Write();
+  return 0;
+}
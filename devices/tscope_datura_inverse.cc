@@ -0,0 +1,85 @@
+// Planning of the DATURA telescope from a target resolution
+
+#include "assembly.h"
+#include "solver.h"
+#include "propagate.h"
+#include "materials.h"
+#include "constants.h"
+#include "log.h"
+
+using namespace std;
+using namespace gblsim;
+using namespace unilog;
+
+int main(int argc, char* argv[]) {
+
+  /*
+   * Answer planning questions for the DATURA telescope at the DESY TB21 beam line backwards:
+   * the maximum distance between DUT and telescope arms, the minimum beam energy and the thickest DUT which still
+   * provide the target resolution at the DUT.
+   */
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+  // Target resolution at the DUT in um:
+  double TARGET = 3.0;
+
+  for (int i = 1; i < argc; i++) {
+    // Setting verbosity:
+    if (std::string(argv[i]) == "-v") {
+      Log::ReportingLevel() = Log::FromString(std::string(argv[++i]));
+      continue;
+    }
+    // Target resolution:
+    if (std::string(argv[i]) == "-t") {
+      TARGET = std::stod(std::string(argv[++i]));
+      continue;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Preparation of the telescope and beam properties:
+
+  // MIMOSA26 telescope planes consist of 50um silicon plus 2x25um Kapton foil only:
+  double MIM26 = 55e-3 / X0_Si + 50e-3 / X0_Kapton;
+  // The intrinsic resolution has been measured to be around 3.24um:
+  double RES = 3.24e-3;
+  // Distance between telescope planes in mm:
+  double DIST = 20;
+
+  // Telescope with distance of the arms to the DUT [mm], beam energy [GeV] and DUT x/X0:
+  auto datura = [=](double dut_dist, double beam, double dut_x0) {
+    std::vector<plane> planes;
+    double position = 0;
+    for(int i = 0; i < 3; i++) {
+      planes.push_back(plane(position,MIM26,true,RES));
+      position += DIST;
+    }
+    position = 2*DIST + 2*dut_dist;
+    for(int i = 0; i < 3; i++) {
+      planes.push_back(plane(position,MIM26,true,RES));
+      position += DIST;
+    }
+    planes.push_back(plane(2*DIST+dut_dist, dut_x0, false));
+    return telescope(planes, beam);
+  };
+
+  // The DUT is the fourth plane along the beam:
+  observable dut(3);
+
+  // Maximum distance of the arms to the DUT at 5 GeV with a 1% X0 DUT:
+  solution dist = solve([&](double d) { return datura(d, 5.0, 0.01); }, dut, TARGET, 5, 300, 1e-3);
+  LOG(logRESULT) << "Maximum DUT distance for " << TARGET << "um: " << dist.parameter << "mm ("
+                 << dist.evaluations << " evaluations)";
+
+  // Minimum beam energy at 20mm DUT distance with a 1% X0 DUT:
+  solution beam = solve([&](double e) { return datura(20, e, 0.01); }, dut, TARGET, 0.5, 6.0, 1e-4);
+  LOG(logRESULT) << "Minimum beam energy for " << TARGET << "um: " << beam.parameter << "GeV ("
+                 << beam.evaluations << " evaluations)";
+
+  // Thickest DUT at 20mm DUT distance and 5 GeV:
+  solution x0 = solve([&](double x) { return datura(20, 5.0, x); }, dut, TARGET, 1e-4, 0.2, 1e-6);
+  LOG(logRESULT) << "Maximum DUT material budget for " << TARGET << "um: " << x0.parameter << " x/X0 ("
+                 << x0.evaluations << " evaluations)";
+
+  return 0;
+}
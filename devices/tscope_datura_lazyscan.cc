@@ -0,0 +1,117 @@
+// Lazy scan of the DATURA telescope layout with early termination
+
+#include <chrono>
+
+#include "assembly.h"
+#include "gridscan.h"
+#include "results.h"
+#include "materials.h"
+#include "constants.h"
+#include "log.h"
+
+using namespace std;
+using namespace gblsim;
+using namespace unilog;
+
+int main(int argc, char* argv[]) {
+
+  /*
+   * Telescope resolution simulation for the DATURA telescope at the DESY TB21 beam line
+   * Six MIMOSA26 planes, intrinsic sensor resolution 3.24um, DUT with 1% x/X0
+   *
+   * Scan of the plane distance and of the distance of the arms to the DUT with the full telescope
+   * fit. Results are consumed while the scan is running, in grid order or in completion order
+   * (-u), and written to the output file. The scan stops at the first layout reaching the target
+   * resolution at the DUT (-r), points not yet computed are skipped.
+   */
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+  std::string filename = "datura-lazyscan.csv";
+  int steps = 50;
+  double target = 0.;
+  bool ordered = true;
+
+  for (int i = 1; i < argc; i++) {
+    // Setting verbosity:
+    if (std::string(argv[i]) == "-v") {
+      Log::ReportingLevel() = Log::FromString(std::string(argv[++i]));
+      continue;
+    }
+    // Output file:
+    if (std::string(argv[i]) == "-f") {
+      filename = std::string(argv[++i]);
+      continue;
+    }
+    // Number of steps per scan parameter:
+    if (std::string(argv[i]) == "-n") {
+      steps = std::stoi(std::string(argv[++i]));
+      continue;
+    }
+    // Target resolution at the DUT in [um]:
+    if (std::string(argv[i]) == "-r") {
+      target = std::stod(std::string(argv[++i]));
+      continue;
+    }
+    // Results in completion order:
+    if (std::string(argv[i]) == "-u") {
+      ordered = false;
+      continue;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Preparation of the telescope and beam properties:
+
+  // MIMOSA26 telescope planes consist of 50um silicon plus 2x25um Kapton foil only:
+  double MIM26 = 55e-3 / X0_Si + 50e-3 / X0_Kapton;
+  // The intrinsic resolution has been measured to be around 3.24um:
+  double RES = 3.24e-3;
+  // Beam energy 5 GeV electrons/positrons at DESY:
+  double BEAM = 5.0;
+
+  // Plane distances from 150mm down to 20mm, DUT distances from 100mm down to 10mm:
+  std::vector<double> distances, dut_distances;
+  for(int s = 0; s < steps; s++) {
+    distances.push_back(150. - 130.*s/steps);
+    dut_distances.push_back(100. - 90.*s/steps);
+  }
+
+  // Called concurrently for all points, the fits log every geometry:
+  TLogLevel level = Log::ReportingLevel();
+  if(level < logDEBUG) Log::ReportingLevel() = logWARNING;
+  gridscan scan({distances, dut_distances}, [&](const std::vector<double>& point) {
+      std::vector<plane> planes;
+      for(int i = 0; i < 6; i++) {
+        planes.push_back(plane(i*point[0] + (i > 2 ? 2*point[1] - point[0] : 0), MIM26, true, RES));
+      }
+      planes.push_back(plane(2*point[0] + point[1], 1e-2, false));
+      telescope tel(planes, BEAM);
+      // The DUT is the fourth plane in z:
+      return std::vector<double>(1, tel.getResolution(3));
+    }, ordered);
+
+  //----------------------------------------------------------------------------
+  // Consume the results while they are computed:
+
+  std::unique_ptr<sink> output = openSink(filename, {"dist", "dut_dist", "resolution"});
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  size_t taken = 0;
+  for(const auto& r : scan) {
+    output->write({r.point[0], r.point[1], r.values[0]});
+    if(++taken % 500 == 0) {
+      LOG(logRESULT) << taken << " of " << scan.size() << " points";
+    }
+    if(r.values[0] < target) {
+      LOG(logRESULT) << "Target reached at plane distance " << r.point[0] << "mm, DUT distance " << r.point[1]
+                     << "mm, resolution " << r.values[0] << "um";
+      break;
+    }
+  }
+  scan.cancel();
+  Log::ReportingLevel() = level;
+  output->flush();
+
+  LOG(logRESULT) << "Took " << taken << " of " << scan.size() << " points in "
+                 << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << "s";
+  return output->good() ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+// DATURA telescope resolution with cluster-size dependent resolution and inefficiency
+
+#include "assembly.h"
+#include "mixture.h"
+#include "propagate.h"
+#include "materials.h"
+#include "constants.h"
+#include "log.h"
+
+using namespace std;
+using namespace gblsim;
+using namespace unilog;
+
+int main(int argc, char* argv[]) {
+
+  /*
+   * Telescope resolution simulation for the DATURA telescope at the DESY TB21 beam line
+   * Six MIMOSA26 planes with 20mm spacing, the intrinsic resolution depends on the cluster
+   * size and planes miss a fraction of the hits. The distribution of the resolution at the
+   * DUT is evaluated over all combinations of plane states.
+   */
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+
+  for (int i = 1; i < argc; i++) {
+    // Setting verbosity:
+    if (std::string(argv[i]) == "-v") {
+      Log::ReportingLevel() = Log::FromString(std::string(argv[++i]));
+      continue;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Preparation of the telescope and beam properties:
+
+  // MIMOSA26 telescope planes consist of 50um silicon plus 2x25um Kapton foil only:
+  double MIM26 = 55e-3 / X0_Si + 50e-3 / X0_Kapton;
+  // The intrinsic resolution has been measured to be around 3.24um:
+  double RES = 3.24e-3;
+  // Distance between telescope planes and of telescope arms and DUT assembly:
+  double DIST = 20;
+  double DUT_DIST = 20;
+  // Beam energy 5 GeV electrons/positrons at DESY:
+  double BEAM = 5.0;
+
+  std::vector<plane> planes;
+  double position = 0;
+  for(int i = 0; i < 3; i++) {
+    planes.push_back(plane(position,MIM26,true,RES));
+    position += DIST;
+  }
+  position = 2*DIST + 2*DUT_DIST;
+  for(int i = 0; i < 3; i++) {
+    planes.push_back(plane(position,MIM26,true,RES));
+    position += DIST;
+  }
+  planes.push_back(plane(2*DIST+DUT_DIST, 0.01, false));
+
+  // MIMOSA26 cluster sizes: single pixels with binary resolution 18.4um/sqrt(12), two-pixel
+  // clusters with the best resolution, larger clusters in between. 1% of the hits are missed:
+  std::vector<state> states = {state(0.30, 5.3e-3), state(0.45, 2.6e-3), state(0.24, 3.4e-3), state::miss(0.01)};
+
+  // Planes are indexed in z order, the DUT is the fourth plane:
+  mixture mytel(planes, BEAM);
+  for(int i = 0; i < 7; i++) {
+    if(i != 3) mytel.setStates(i, states);
+  }
+
+  distribution dut = mytel.evaluate(3);
+  LOG(logRESULT) << "Mean track resolution at DUT: " << dut.mean() << "um";
+  LOG(logRESULT) << "Median: " << dut.quantile(0.5) << "um, 90% quantile: " << dut.quantile(0.9) << "um";
+  LOG(logRESULT) << "Tracks not reconstructed: " << dut.untracked << ", probability neglected: " << dut.pruned;
+
+  // Compare to a single intrinsic resolution:
+  telescope fixed(planes, BEAM);
+  LOG(logRESULT) << "Track resolution at DUT for fixed intrinsic resolution: " << fixed.getResolution(3) << "um";
+  return 0;
+}
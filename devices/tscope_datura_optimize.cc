@@ -0,0 +1,91 @@
+// Layout optimization for the DATURA telescope
+
+#include "assembly.h"
+#include "optimizer.h"
+#include "propagate.h"
+#include "materials.h"
+#include "constants.h"
+#include "log.h"
+
+using namespace std;
+using namespace gblsim;
+using namespace unilog;
+
+int main(int argc, char* argv[]) {
+
+  /*
+   * Optimal plane positions of the DATURA telescope at the DESY TB21 beam line for the
+   * resolution at the DUT. The four inner telescope planes can be moved, the outermost planes
+   * are fixed by the mechanics. All planes keep a minimum distance for the plane holders.
+   */
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+  // Messages are logged from the worker threads:
+  SetLogOutput::Asynchronous() = true;
+  unsigned int starts = 16;
+
+  for (int i = 1; i < argc; i++) {
+    // Setting verbosity:
+    if (std::string(argv[i]) == "-v") {
+      Log::ReportingLevel() = Log::FromString(std::string(argv[++i]));
+      continue;
+    }
+    // Number of starting points:
+    if (std::string(argv[i]) == "-n") {
+      starts = std::stoi(std::string(argv[++i]));
+      continue;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Preparation of the telescope and beam properties:
+
+  // MIMOSA26 telescope planes consist of 50um silicon plus 2x25um Kapton foil only:
+  double MIM26 = 55e-3 / X0_Si + 50e-3 / X0_Kapton;
+  // The intrinsic resolution has been measured to be around 3.24um:
+  double RES = 3.24e-3;
+  // Beam energy 5 GeV electrons/positrons at DESY:
+  double BEAM = 5.0;
+  // DUT with 1% radiation length:
+  double DUT_X0 = 0.01;
+
+  // Start from 150mm plane spacing and the DUT in the centre:
+  std::vector<plane> planes;
+  double position = 0;
+  for(int i = 0; i < 3; i++) {
+    planes.push_back(plane(position,MIM26,true,RES));
+    position += 150;
+  }
+  position = 2*150 + 2*20;
+  for(int i = 0; i < 3; i++) {
+    planes.push_back(plane(position,MIM26,true,RES));
+    position += 150;
+  }
+  planes.push_back(plane(2*150+20, DUT_X0, false));
+
+  //----------------------------------------------------------------------------
+  // Optimize the layout:
+
+  optimizer opt(planes, BEAM);
+  // Inner planes of both arms within the mechanical range of the rails, planes are indexed in z
+  // order with the DUT as fourth plane:
+  opt.setMovable(1, 10, 290);
+  opt.setMovable(2, 10, 310);
+  opt.setMovable(4, 330, 630);
+  opt.setMovable(5, 350, 630);
+  opt.setMinimumSpacing(15);
+  opt.addTarget(target(3));
+
+  telescope before(planes, BEAM);
+  LOG(logRESULT) << "Track resolution at DUT before optimization: " << before.getResolution(3);
+
+  layout best = opt.optimize(starts);
+  for(size_t p = 0; p < best.planes.size(); p++) {
+    LOG(logRESULT) << "Plane " << p << " at z = " << best.planes.at(p).position() << "mm";
+  }
+
+  telescope after(best.planes, BEAM);
+  LOG(logRESULT) << "Track resolution at DUT after optimization: " << after.getResolution(3)
+                 << (best.feasible ? "" : " (layout violates constraints)");
+  return 0;
+}
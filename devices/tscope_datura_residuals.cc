@@ -0,0 +1,86 @@
+// Residual widths of the DATURA telescope planes
+
+#include <chrono>
+#include <cmath>
+
+#include "assembly.h"
+#include "materials.h"
+#include "constants.h"
+#include "log.h"
+
+using namespace std;
+using namespace gblsim;
+using namespace unilog;
+
+int main(int argc, char* argv[]) {
+
+  /*
+   * Telescope resolution simulation for the DATURA telescope at the DESY TB21 beam line
+   * Six MIMOSA26 planes with 20mm spacing, intrinsic sensor resolution 3.24um, DUT with 1% x/X0
+   *
+   * Biased and unbiased residual widths of all telescope planes. The unbiased widths from the
+   * single fit of getResidualWidths() are compared with the intrinsic resolution combined with
+   * the track resolution of a second telescope in which the plane does not measure.
+   */
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+
+  for (int i = 1; i < argc; i++) {
+    // Setting verbosity:
+    if (std::string(argv[i]) == "-v") {
+      Log::ReportingLevel() = Log::FromString(std::string(argv[++i]));
+      continue;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Preparation of the telescope and beam properties:
+
+  // MIMOSA26 telescope planes consist of 50um silicon plus 2x25um Kapton foil only:
+  double MIM26 = 55e-3 / X0_Si + 50e-3 / X0_Kapton;
+  // The intrinsic resolution has been measured to be around 3.24um:
+  double RES = 3.24e-3;
+  // Distance between telescope planes in mm:
+  double DIST = 20;
+  // Distance of the arms to the DUT in mm:
+  double DUT_DIST = 20;
+  // Beam energy 5 GeV electrons/positrons at DESY:
+  double BEAM = 5.0;
+
+  // Planes in z order, the DUT is the fourth plane:
+  std::vector<plane> planes;
+  for(int i = 0; i < 6; i++) {
+    planes.push_back(plane(i*DIST + (i > 2 ? 2*DUT_DIST - DIST : 0), MIM26, true, RES));
+  }
+  planes.insert(planes.begin() + 3, plane(2*DIST + DUT_DIST, 1e-2, false));
+
+  //----------------------------------------------------------------------------
+  // Residual widths from a single fit:
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  telescope mytel(planes, BEAM);
+  std::vector<residual> residuals = mytel.getResidualWidths();
+  double single = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  //----------------------------------------------------------------------------
+  // Unbiased widths from a second telescope per plane without its measurement:
+
+  std::vector<double> unbiased;
+  start = std::chrono::steady_clock::now();
+  for(const auto& r : residuals) {
+    std::vector<plane> excluded = planes;
+    excluded.at(r.plane) = plane(planes.at(r.plane).position(), planes.at(r.plane).material(), false);
+    telescope exctel(excluded, BEAM);
+    double track = exctel.getResolution(r.plane);
+    unbiased.push_back(std::sqrt(RES*RES*1E6 + track*track));
+  }
+  double separate = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  for(size_t i = 0; i < residuals.size(); i++) {
+    LOG(logRESULT) << "Plane " << residuals.at(i).plane << ": biased " << residuals.at(i).biased.first
+                   << "um, unbiased " << residuals.at(i).unbiased.first << "um, second telescope "
+                   << unbiased.at(i) << "um";
+  }
+  LOG(logRESULT) << "Single fit " << single*1E3 << "ms, one telescope per plane " << separate*1E3 << "ms";
+  return 0;
+}
@@ -0,0 +1,133 @@
+// DATURA telescope resolution for geometry samples from a file
+
+#include <chrono>
+#include <random>
+
+#include "assembly.h"
+#include "samples.h"
+#include "results.h"
+#include "statistics.h"
+#include "materials.h"
+#include "constants.h"
+#include "log.h"
+
+using namespace std;
+using namespace gblsim;
+using namespace unilog;
+
+int main(int argc, char* argv[]) {
+
+  /*
+   * Telescope resolution simulation for the DATURA telescope at the DESY TB21 beam line
+   * Six MIMOSA26 planes with 150mm spacing, intrinsic sensor resolution 3.24um
+   * DUT with 1% x/X0 at 20mm from the third plane
+   *
+   * The geometry varies with samples read from a columnar file (see samples.h), e.g. exported
+   * from alignment fits, instead of independent Gaussian errors. The resolution at the DUT is
+   * written for every sample. With -g, a sample file with Gaussian variations of positions,
+   * material and resolutions is generated first.
+   */
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+  std::string infile = "datura_samples.col";
+  std::string outfile = "datura_samples_results.col";
+  size_t generate = 0;
+
+  for (int i = 1; i < argc; i++) {
+    // Setting verbosity:
+    if (std::string(argv[i]) == "-v") {
+      Log::ReportingLevel() = Log::FromString(std::string(argv[++i]));
+      continue;
+    }
+    // Sample file:
+    if (std::string(argv[i]) == "-i") {
+      infile = std::string(argv[++i]);
+      continue;
+    }
+    // Output file, columnar or text by extension:
+    if (std::string(argv[i]) == "-o") {
+      outfile = std::string(argv[++i]);
+      continue;
+    }
+    // Generate a sample file with this many samples:
+    if (std::string(argv[i]) == "-g") {
+      generate = std::stoul(std::string(argv[++i]));
+      continue;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Preparation of the telescope and beam properties:
+
+  // MIMOSA26 telescope planes consist of 50um silicon plus 2x25um Kapton foil only:
+  double MIM26 = 55e-3 / X0_Si + 50e-3 / X0_Kapton;
+  // The intrinsic resolution has been measured to be around 3.24um:
+  double RES = 3.24e-3;
+  // Beam energy 5 GeV electrons/positrons at DESY:
+  double BEAM = 5.0;
+  double DUT_DIST = 20;
+  double DUT_X0 = 1e-2;
+
+  std::vector<plane> datura;
+  for(int i = 0; i < 6; i++) {
+    datura.push_back(plane::active(150.*i + (i > 2 ? 2*DUT_DIST - 150. : 0.), MIM26, RES));
+  }
+  // The DUT as last plane, independent of its position:
+  datura.push_back(plane::inactive(300. + DUT_DIST, DUT_X0));
+
+  //----------------------------------------------------------------------------
+  // Sample generation, 100um position, 10% material and 0.1um resolution spread:
+
+  if(generate > 0) {
+    std::vector<std::string> columns = {"beam"};
+    for(size_t p = 0; p < datura.size(); p++) {
+      columns.push_back("z" + std::to_string(p));
+      columns.push_back("material" + std::to_string(p));
+      if(datura[p].measurement()) columns.push_back("resolution" + std::to_string(p));
+    }
+    columnwriter samples(infile, columns);
+    std::mt19937_64 random(42);
+    std::normal_distribution<double> gauss(0., 1.);
+    std::vector<double> record;
+    for(size_t s = 0; s < generate; s++) {
+      record.assign(1, BEAM*(1. + 0.05*gauss(random)));
+      for(const auto& pl : datura) {
+        record.push_back(pl.position() + 0.1*gauss(random));
+        record.push_back(pl.material()*(1. + 0.1*gauss(random)));
+        if(pl.measurement()) record.push_back(pl.resolution().first + 0.1e-3*gauss(random));
+      }
+      samples.write(record);
+    }
+    samples.flush();
+    if(!samples.good()) return 1;
+    LOG(logINFO) << "Generated " << generate << " samples in " << infile;
+  }
+
+  //----------------------------------------------------------------------------
+  // Evaluation of all samples:
+
+  columnreader samples(infile);
+  if(!samples.good()) return 1;
+  sampleevaluator evaluator(datura, BEAM, 6);
+  std::unique_ptr<sink> output = openSink(outfile, evaluator.getColumns());
+
+  // The fits log every geometry:
+  TLogLevel level = Log::ReportingLevel();
+  if(level < logDEBUG) Log::ReportingLevel() = logWARNING;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  bool valid = evaluator.evaluate(samples, *output);
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  Log::ReportingLevel() = level;
+  output.reset();
+  if(!valid) return 1;
+  LOG(logRESULT) << "Evaluated " << samples.getRecords() << " samples in " << elapsed << "s, "
+                 << 1e6*elapsed/samples.getRecords() << "us per sample, results in " << outfile;
+
+  // Spread of the resolution over the samples:
+  if(outfile.find(".csv") != std::string::npos || outfile.find(".jsonl") != std::string::npos) return 0;
+  columnreader results(outfile);
+  moments resolution;
+  for(double r : results.get(results.getColumn("resolution_x"))) resolution.fill(r);
+  LOG(logRESULT) << "Resolution at DUT: mean " << resolution.mean() << "um, standard deviation " << resolution.sigma() << "um";
+  return 0;
+}
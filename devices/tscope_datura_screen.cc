@@ -0,0 +1,76 @@
+// Pruned design scan for the DATURA telescope
+
+#include "assembly.h"
+#include "estimate.h"
+#include "propagate.h"
+#include "materials.h"
+#include "constants.h"
+#include "log.h"
+
+using namespace std;
+using namespace gblsim;
+using namespace unilog;
+
+int main(int argc, char* argv[]) {
+
+  /*
+   * Scan of plane distance and distance of the arms to the DUT for the DATURA telescope at
+   * the DESY TB21 beam line. Only candidates whose closed-form lower bound on the resolution
+   * at the DUT can beat the current best ones are fitted.
+   */
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+
+  for (int i = 1; i < argc; i++) {
+    // Setting verbosity:
+    if (std::string(argv[i]) == "-v") {
+      Log::ReportingLevel() = Log::FromString(std::string(argv[++i]));
+      continue;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Preparation of the telescope and beam properties:
+
+  // MIMOSA26 telescope planes consist of 50um silicon plus 2x25um Kapton foil only:
+  double MIM26 = 55e-3 / X0_Si + 50e-3 / X0_Kapton;
+  // The intrinsic resolution has been measured to be around 3.24um:
+  double RES = 3.24e-3;
+  // Beam energy 5 GeV electrons/positrons at DESY:
+  double BEAM = 5.0;
+
+  std::vector<std::vector<plane>> candidates;
+  std::vector<std::pair<double,double>> parameters;
+  for(double dist = 20; dist < 151; dist += 5) {
+    for(double dut_dist = 10; dut_dist < 101; dut_dist += 5) {
+      std::vector<plane> planes;
+      double position = 0;
+      for(int i = 0; i < 3; i++) {
+        planes.push_back(plane(position,MIM26,true,RES));
+        position += dist;
+      }
+      position = 2*dist + 2*dut_dist;
+      for(int i = 0; i < 3; i++) {
+        planes.push_back(plane(position,MIM26,true,RES));
+        position += dist;
+      }
+      planes.push_back(plane(2*dist+dut_dist, 0.01, false));
+      candidates.push_back(planes);
+      parameters.push_back(std::make_pair(dist, dut_dist));
+    }
+  }
+
+  // Silence the output of every single telescope:
+  TLogLevel level = Log::ReportingLevel();
+  Log::ReportingLevel() = std::min(level, logWARNING);
+  size_t fits = 0;
+  std::vector<std::pair<size_t, double>> best = screen(candidates, 3, BEAM, 5, fits);
+  Log::ReportingLevel() = level;
+
+  LOG(logINFO) << "Scanned " << candidates.size() << " layouts with " << fits << " full fits";
+  for(const auto& b : best) {
+    LOG(logRESULT) << "Plane distance " << parameters.at(b.first).first << "mm, DUT distance "
+                   << parameters.at(b.first).second << "mm: resolution at DUT " << b.second << "um";
+  }
+  return 0;
+}
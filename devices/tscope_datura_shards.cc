@@ -0,0 +1,188 @@
+// Sharded toy Monte Carlo and design scan for the DATURA telescope
+
+#include <cmath>
+#include <memory>
+
+#include "assembly.h"
+#include "trackmodel.h"
+#include "toymc.h"
+#include "shards.h"
+#include "results.h"
+#include "threadpool.h"
+#include "materials.h"
+#include "constants.h"
+#include "log.h"
+
+using namespace std;
+using namespace gblsim;
+using namespace unilog;
+
+int main(int argc, char* argv[]) {
+
+  /*
+   * Telescope resolution simulation for the DATURA telescope at the DESY TB21 beam line, split
+   * into shards for batch farms. Either toy tracks are generated and the residuals at the DUT are
+   * accumulated (-m toymc), or plane distance and DUT material are scanned (-m scan), one grid
+   * row per item. Every shard (-s i/n) runs as its own process and keeps its partial results in
+   * a checkpoint file (-c), which is saved periodically (-i seconds) and resumed when the shard
+   * is started again. All checkpoint files given without option are merged into the result of
+   * a single run, for the scan written to the output file (-o).
+   *
+   *   tscope_datura_shards -m toymc -n 100000000 -s 0/4 -c toymc0.ckp     (and 1/4, 2/4, 3/4)
+   *   tscope_datura_shards -m toymc -n 100000000 toymc0.ckp toymc1.ckp toymc2.ckp toymc3.ckp
+   */
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+  // Messages are logged from the worker threads:
+  SetLogOutput::Asynchronous() = true;
+  std::string mode = "toymc";
+  size_t tracks = 10000000;
+  int steps = 100;
+  shard part;
+  std::string filename;
+  std::string outfile = "datura-shards.col";
+  double interval = 60.;
+  std::vector<std::string> merge;
+
+  for (int i = 1; i < argc; i++) {
+    // Setting verbosity:
+    if (std::string(argv[i]) == "-v") {
+      Log::ReportingLevel() = Log::FromString(std::string(argv[++i]));
+      continue;
+    }
+    // Study, toymc or scan:
+    if (std::string(argv[i]) == "-m") {
+      mode = std::string(argv[++i]);
+      continue;
+    }
+    // Number of tracks:
+    if (std::string(argv[i]) == "-n") {
+      tracks = std::stoul(std::string(argv[++i]));
+      continue;
+    }
+    // Number of steps per scan parameter:
+    if (std::string(argv[i]) == "-g") {
+      steps = std::stoi(std::string(argv[++i]));
+      continue;
+    }
+    // Shard to run:
+    if (std::string(argv[i]) == "-s") {
+      if(!shard::parse(std::string(argv[++i]), part)) {
+        LOG(logERROR) << "Invalid shard " << argv[i] << ", expected i/n";
+        return 1;
+      }
+      continue;
+    }
+    // Checkpoint file of the shard:
+    if (std::string(argv[i]) == "-c") {
+      filename = std::string(argv[++i]);
+      continue;
+    }
+    // Seconds between checkpoints:
+    if (std::string(argv[i]) == "-i") {
+      interval = std::stod(std::string(argv[++i]));
+      continue;
+    }
+    // Scan output file:
+    if (std::string(argv[i]) == "-o") {
+      outfile = std::string(argv[++i]);
+      continue;
+    }
+    merge.push_back(std::string(argv[i]));
+  }
+
+  if((mode != "toymc" && mode != "scan") || (merge.empty() && filename.empty())) {
+    LOG(logERROR) << "Usage: " << argv[0] << " [-m toymc|scan] [-n TRACKS] [-g STEPS] -s i/n -c CHECKPOINT [-i SECONDS]";
+    LOG(logERROR) << "       " << argv[0] << " [-m toymc|scan] [-n TRACKS] [-g STEPS] [-o FILE] CHECKPOINT...";
+    return 1;
+  }
+
+  //----------------------------------------------------------------------------
+  // Preparation of the telescope and beam properties:
+
+  // MIMOSA26 telescope planes consist of 50um silicon plus 2x25um Kapton foil only:
+  double MIM26 = 55e-3 / X0_Si + 50e-3 / X0_Kapton;
+  // The intrinsic resolution has been measured to be around 3.24um:
+  double RES = 3.24e-3;
+  // Distance between telescope planes and of telescope arms and DUT assembly:
+  double DIST = 20;
+  double DUT_DIST = 20;
+  // Beam energy 5 GeV electrons/positrons at DESY:
+  double BEAM = 5.0;
+
+  auto datura = [&](double dist, double dut_x0) {
+    std::vector<plane> planes;
+    for(int i = 0; i < 6; i++) {
+      planes.push_back(plane(i*dist + (i > 2 ? 2*DUT_DIST - dist : 0), MIM26, true, RES));
+    }
+    planes.push_back(plane(2*dist + DUT_DIST, dut_x0, false));
+    return planes;
+  };
+
+  // Grid row r scans the DUT material from 0.1% to 10% radiation length at plane distance
+  // 20mm + 130mm*r/steps, three values per point:
+  auto row = [&](size_t r) {
+    std::vector<double> records;
+    double dist = 20 + 130.*r/steps;
+    for(int m = 0; m < steps; m++) {
+      double dut_x0 = 1e-3*std::pow(100., static_cast<double>(m)/steps);
+      std::vector<layer<double>> layers;
+      for(const auto& pl : datura(dist, dut_x0)) layers.push_back(layer<double>(pl));
+      trackmodel<double> model(layers, BEAM);
+      records.insert(records.end(), {dist, dut_x0, std::sqrt(model.getVariance(6))*1e3});
+    }
+    return records;
+  };
+
+  // Checkpoints are only resumed and merged for the same study, the DUT is the fourth plane in z:
+  toymc toy(datura(DIST, 0.01), BEAM);
+  std::string study = (mode == "toymc" ? toy.describe(3, tracks, 0) : "DATURA scan " + std::to_string(steps) + " steps");
+  size_t items = (mode == "toymc" ? toymc::getBlocks(tracks) : steps);
+  checkpoint blocks(study, items, filename, interval);
+
+  //----------------------------------------------------------------------------
+  // Run one shard:
+
+  if(merge.empty()) {
+    if(!blocks.load()) return 1;
+    if(mode == "toymc") return toy.runShard(3, tracks, 0, part, blocks) ? 0 : 1;
+
+    threadpool::global().parallel_for(part.end(items) - part.begin(items), [&](size_t i) {
+        size_t r = part.begin(items) + i;
+        if(!blocks.has(r)) blocks.put(r, row(r));
+      });
+    return blocks.save() ? 0 : 1;
+  }
+
+  //----------------------------------------------------------------------------
+  // Merge the checkpoints of all shards:
+
+  for(const auto& file : merge) {
+    checkpoint shard_blocks(study, items, file);
+    if(!shard_blocks.load() || !blocks.add(shard_blocks)) return 1;
+  }
+  if(!blocks.complete()) {
+    LOG(logERROR) << "Only " << blocks.getCompleted() << " of " << items << " items are complete, missing shards?";
+    return 1;
+  }
+
+  if(mode == "toymc") {
+    validation result = toy.merge(3, tracks, blocks);
+    LOG(logRESULT) << "Residual RMS " << result.rms << " +- " << result.rms_error << "um for " << result.tracks
+                   << " tracks, core fit " << result.core.sigma << " +- " << result.core.sigma_error
+                   << "um, central 68% half width " << result.quantile_width << "um, predicted " << result.predicted << "um";
+    return 0;
+  }
+
+  std::unique_ptr<sink> output = openSink(outfile, {"dist", "dut_x0", "resolution"});
+  for(size_t r = 0; r < items; r++) {
+    std::vector<double> records = blocks.get(r);
+    for(size_t i = 0; i + 3 <= records.size(); i += 3) {
+      output->write(std::vector<double>(records.begin() + i, records.begin() + i + 3));
+    }
+  }
+  output->flush();
+  if(!output->good()) return 1;
+  LOG(logRESULT) << "Merged " << items*steps << " scan points into " << outfile;
+  return 0;
+}
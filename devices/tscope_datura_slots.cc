@@ -0,0 +1,79 @@
+// Slot assignment search for a telescope stand with fixed mounting slots
+
+#include <sstream>
+
+#include "assembly.h"
+#include "slotsearch.h"
+#include "propagate.h"
+#include "materials.h"
+#include "constants.h"
+#include "log.h"
+
+using namespace std;
+using namespace gblsim;
+using namespace unilog;
+
+int main(int argc, char* argv[]) {
+
+  /*
+   * Telescope stand with 13 mounting slots in steps of 50mm at the DESY TB21 beam line.
+   * Six MIMOSA26 planes and two Timepix3 timing planes are at hand, and the DUT can go
+   * into any of the inner slots. The search returns the best assignments of sensors and
+   * DUT to the slots for the resolution at the DUT.
+   */
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+  unsigned int best = 10;
+
+  for (int i = 1; i < argc; i++) {
+    // Setting verbosity:
+    if (std::string(argv[i]) == "-v") {
+      Log::ReportingLevel() = Log::FromString(std::string(argv[++i]));
+      continue;
+    }
+    // Number of configurations to return:
+    if (std::string(argv[i]) == "-k") {
+      best = std::stoi(std::string(argv[++i]));
+      continue;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Preparation of the slots and sensors:
+
+  std::vector<double> slots;
+  for(int i = 0; i < 13; i++) slots.push_back(50.*i);
+
+  // MIMOSA26 telescope planes consist of 50um silicon plus 2x25um Kapton foil only:
+  double MIM26 = 55e-3 / X0_Si + 50e-3 / X0_Kapton;
+  // Timepix3 assemblies with 300um silicon sensor and 700um readout chip, 55um pitch:
+  double TPX3 = 1000e-3 / X0_Si;
+  std::vector<device> devices = {device("M26", MIM26, 3.24e-3, 6), device("Timepix3", TPX3, 55e-3/sqrt(12), 2)};
+
+  // DUT with 1% radiation length, beam energy 5 GeV electrons/positrons at DESY:
+  slotsearch search(slots, devices, 0.01, 5.0);
+  // Require at least three planes for the track fit and mount at most eight:
+  search.setPlanes(3, 8);
+  search.setDutSlots({3, 4, 5, 6, 7, 8, 9});
+
+  //----------------------------------------------------------------------------
+  // Search and report the best configurations:
+
+  std::vector<configuration> configs = search.search(best);
+  for(const auto& config : configs) {
+    std::stringstream layout;
+    for(auto s : config.slots) {
+      if(s == slot_empty) layout << " .  ";
+      else if(s == slot_dut) layout << "DUT ";
+      else layout << devices.at(s).name.substr(0, 3) << " ";
+    }
+    LOG(logRESULT) << layout.str() << " resolution at DUT " << config.resolution << "um";
+  }
+
+  // Cross-check the best configuration with the full telescope:
+  if(!configs.empty()) {
+    telescope mytel(configs.front().planes, 5.0);
+    LOG(logINFO) << "Telescope resolution of best configuration: " << mytel.getResolution(configs.front().dut) << "um";
+  }
+  return 0;
+}
@@ -0,0 +1,89 @@
+// DATURA telescope resolution across the beam spot with a DUT material map
+
+#include "assembly.h"
+#include "spotscan.h"
+#include "propagate.h"
+#include "materials.h"
+#include "constants.h"
+#include "log.h"
+
+using namespace std;
+using namespace gblsim;
+using namespace unilog;
+
+int main(int argc, char* argv[]) {
+
+  /*
+   * Telescope resolution simulation for the DATURA telescope at the DESY TB21 beam line
+   * The DUT is a 300um silicon sensor of 10x10mm^2 glued to a 1.6mm PCB with a cut-out of
+   * 8x8mm^2, and a 1mm thick aluminium cooling pipe runs along y at x = 3mm. The resolution
+   * at the DUT is mapped across the board and averaged over a Gaussian beam spot.
+   */
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+
+  for (int i = 1; i < argc; i++) {
+    // Setting verbosity:
+    if (std::string(argv[i]) == "-v") {
+      Log::ReportingLevel() = Log::FromString(std::string(argv[++i]));
+      continue;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Preparation of the telescope and beam properties:
+
+  // MIMOSA26 telescope planes consist of 50um silicon plus 2x25um Kapton foil only:
+  double MIM26 = 55e-3 / X0_Si + 50e-3 / X0_Kapton;
+  // The intrinsic resolution has been measured to be around 3.24um:
+  double RES = 3.24e-3;
+  // Distance between telescope planes and of telescope arms and DUT assembly:
+  double DIST = 20;
+  double DUT_DIST = 20;
+  // Beam energy 5 GeV electrons/positrons at DESY:
+  double BEAM = 5.0;
+
+  std::vector<plane> planes;
+  double position = 0;
+  for(int i = 0; i < 3; i++) {
+    planes.push_back(plane(position,MIM26,true,RES));
+    position += DIST;
+  }
+  position = 2*DIST + 2*DUT_DIST;
+  for(int i = 0; i < 3; i++) {
+    planes.push_back(plane(position,MIM26,true,RES));
+    position += DIST;
+  }
+  // Outside of its map, the DUT board is bare PCB:
+  planes.push_back(plane(2*DIST+DUT_DIST, 1.6 / X0_PCB, false));
+
+  // DUT material map in 0.1mm cells over 20x20mm^2 centred on the beam axis:
+  map2d dut(200, 200, 0., -10, -10, 0.1, 0.1);
+  for(size_t iy = 0; iy < dut.ny; iy++) {
+    for(size_t ix = 0; ix < dut.nx; ix++) {
+      double x = dut.x(ix), y = dut.y(iy);
+      double material = 0;
+      if(std::fabs(x) > 4 || std::fabs(y) > 4) material += 1.6 / X0_PCB;
+      if(std::fabs(x) < 5 && std::fabs(y) < 5) material += 0.3 / X0_Si;
+      if(std::fabs(x - 3) < 0.5) material += 1.0 / X0_Al;
+      dut(ix, iy) = material;
+    }
+  }
+
+  spotscan scan(planes, BEAM);
+  // The DUT is the fourth plane in z:
+  scan.setMaterialMap(3, dut);
+
+  //----------------------------------------------------------------------------
+  // Resolution map and beam spot average:
+
+  map2d resolution = scan.getResolutionMap(3, dut);
+  for(size_t ix = 0; ix < resolution.nx; ix += 10) {
+    LOG(logRESULT) << "Track resolution at DUT at x = " << resolution.x(ix) << "mm, y = 0mm: "
+                   << resolution(ix, resolution.ny/2) << "um";
+  }
+
+  map2d spot = spotscan::gaussian(dut, 0, 0, 3, 3);
+  LOG(logRESULT) << "Track resolution at DUT averaged over the beam spot: " << scan.getAverageResolution(3, spot) << "um";
+  return 0;
+}
@@ -0,0 +1,95 @@
+// Surrogate lookup table for the DATURA telescope resolution at the DUT
+
+#include <algorithm>
+#include <chrono>
+
+#include "assembly.h"
+#include "surrogate.h"
+#include "propagate.h"
+#include "materials.h"
+#include "constants.h"
+#include "log.h"
+
+using namespace std;
+using namespace gblsim;
+using namespace unilog;
+
+int main(int argc, char* argv[]) {
+
+  /*
+   * Telescope resolution at the DUT for the DATURA telescope at the DESY TB21 beam line
+   * as function of the plane spacing, the beam energy and the DUT material budget.
+   * The parameter box is sampled once and stored in a file, subsequent runs read the
+   * file and answer queries from the table.
+   */
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+  std::string filename = "datura-surrogate.bin";
+
+  for (int i = 1; i < argc; i++) {
+    // Setting verbosity:
+    if (std::string(argv[i]) == "-v") {
+      Log::ReportingLevel() = Log::FromString(std::string(argv[++i]));
+      continue;
+    }
+    // Surrogate file:
+    if (std::string(argv[i]) == "-f") {
+      filename = std::string(argv[++i]);
+      continue;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Preparation of the telescope and beam properties:
+
+  // MIMOSA26 telescope planes consist of 50um silicon plus 2x25um Kapton foil only:
+  double MIM26 = 55e-3 / X0_Si + 50e-3 / X0_Kapton;
+  // The intrinsic resolution has been measured to be around 3.24um:
+  double RES = 3.24e-3;
+  // Distance of telescope arms and DUT assembly:
+  double DUT_DIST = 20;
+
+  // Full evaluation: parameters are plane distance [mm], beam energy [GeV] and DUT x/X0
+  evaluator datura = [=](const std::vector<double>& parameters) {
+    double dist = parameters.at(0);
+    std::vector<plane> planes;
+    double position = 0;
+    for(int i = 0; i < 3; i++) {
+      planes.push_back(plane(position,MIM26,true,RES));
+      position += dist;
+    }
+    position = 2*dist + 2*DUT_DIST;
+    for(int i = 0; i < 3; i++) {
+      planes.push_back(plane(position,MIM26,true,RES));
+      position += dist;
+    }
+    planes.push_back(plane(2*dist+DUT_DIST, parameters.at(2), false));
+    telescope mytel(planes, parameters.at(1));
+    return mytel.getResolution(3);
+  };
+
+  surrogate table = surrogate::read(filename);
+  if(table.getAxes().empty()) {
+    LOG(logINFO) << "Sampling parameter box, this takes a while...";
+    // Silence the output of every single telescope while sampling:
+    TLogLevel level = Log::ReportingLevel();
+    Log::ReportingLevel() = std::min(level, logWARNING);
+    table = surrogate::build({axis("distance", 20, 150, 27), axis("energy", 1, 6, 21), axis("dut_x0", 0.001, 0.05, 15)}, datura);
+    Log::ReportingLevel() = level;
+    table.write(filename);
+  }
+  LOG(logINFO) << "Maximum interpolation error in parameter box: " << table.getMaxError() << "um";
+
+  //----------------------------------------------------------------------------
+  // Query the resolution for a scan of the plane distance:
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(double dist = 20; dist < 151; dist += 1.) {
+    std::vector<double> parameters = {dist, 5.0, 0.01};
+    LOG(logRESULT) << "Track resolution at DUT with plane dist " << dist << "mm " << table.query(parameters, 0.01, datura);
+  }
+  std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+  LOG(logINFO) << "Answered 131 queries in " << std::chrono::duration<double,std::micro>(stop - start).count()
+               << "us, " << table.getFallbacks() << " needed the full evaluation";
+  return 0;
+}
@@ -0,0 +1,112 @@
+// Toy Monte Carlo validation of the DATURA telescope resolution
+
+#include <chrono>
+#include <fstream>
+
+#include "assembly.h"
+#include "toymc.h"
+#include "propagate.h"
+#include "materials.h"
+#include "constants.h"
+#include "log.h"
+
+using namespace std;
+using namespace gblsim;
+using namespace unilog;
+
+int main(int argc, char* argv[]) {
+
+  /*
+   * Telescope resolution simulation for the DATURA telescope at the DESY TB21 beam line
+   * Toy tracks are generated with scattering at all scatterers and smeared hits, fitted, and
+   * the residuals at the DUT are compared with the predicted track resolution. The residual
+   * histogram is written to file while tracks are being processed.
+   */
+
+  Log::ReportingLevel() = Log::FromString("INFO");
+  // Messages are logged from the worker threads:
+  SetLogOutput::Asynchronous() = true;
+  size_t tracks = 1000000;
+  std::string filename = "datura-toymc.txt";
+
+  for (int i = 1; i < argc; i++) {
+    // Setting verbosity:
+    if (std::string(argv[i]) == "-v") {
+      Log::ReportingLevel() = Log::FromString(std::string(argv[++i]));
+      continue;
+    }
+    // Number of tracks:
+    if (std::string(argv[i]) == "-n") {
+      tracks = std::stoul(std::string(argv[++i]));
+      continue;
+    }
+    // Histogram output file:
+    if (std::string(argv[i]) == "-f") {
+      filename = std::string(argv[++i]);
+      continue;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Preparation of the telescope and beam properties:
+
+  // MIMOSA26 telescope planes consist of 50um silicon plus 2x25um Kapton foil only:
+  double MIM26 = 55e-3 / X0_Si + 50e-3 / X0_Kapton;
+  // The intrinsic resolution has been measured to be around 3.24um:
+  double RES = 3.24e-3;
+  // Distance between telescope planes and of telescope arms and DUT assembly:
+  double DIST = 20;
+  double DUT_DIST = 20;
+  // Beam energy 5 GeV electrons/positrons at DESY:
+  double BEAM = 5.0;
+
+  std::vector<plane> planes;
+  double position = 0;
+  for(int i = 0; i < 3; i++) {
+    planes.push_back(plane(position,MIM26,true,RES));
+    position += DIST;
+  }
+  position = 2*DIST + 2*DUT_DIST;
+  for(int i = 0; i < 3; i++) {
+    planes.push_back(plane(position,MIM26,true,RES));
+    position += DIST;
+  }
+  planes.push_back(plane(2*DIST+DUT_DIST, 0.01, false));
+
+  telescope mytel(planes, BEAM);
+  LOG(logRESULT) << "Predicted track resolution at DUT: " << mytel.getResolution(3) << "um";
+
+  //----------------------------------------------------------------------------
+  // Generate and fit toy tracks, rewriting the histogram file every million tracks:
+
+  toymc toy(planes, BEAM);
+  size_t next = 1000000;
+  toy.setMonitor([&filename, &next](const histogram& residuals, size_t processed) {
+      if(processed < next) return;
+      next += 1000000;
+      std::ofstream out(filename.c_str());
+      residuals.write(out);
+      LOG(logINFO) << processed << " tracks processed";
+    });
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  // The DUT is the fourth plane in z:
+  validation gaussian = toy.run(3, tracks);
+  std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+  LOG(logRESULT) << "Gaussian scattering: residual RMS " << gaussian.rms << " +- " << gaussian.rms_error
+                 << "um for " << gaussian.tracks << " tracks in " << std::chrono::duration<double>(stop - start).count() << "s";
+  LOG(logRESULT) << "Gaussian scattering: unbinned core fit " << gaussian.core.sigma << " +- " << gaussian.core.sigma_error
+                 << "um, central 68% half width " << gaussian.quantile_width << "um";
+
+  std::ofstream out(filename.c_str());
+  gaussian.residuals.write(out);
+
+  // 2% of the kinks with three times the Highland width:
+  toy.setMonitor(toymc::monitor());
+  toy.setTails(0.02, 3.);
+  validation tails = toy.run(3, tracks, 1);
+  LOG(logRESULT) << "Scattering with tails: residual RMS " << tails.rms << " +- " << tails.rms_error << "um, core "
+                 << tails.core.sigma << " +- " << tails.core.sigma_error << "um, central 68% half width "
+                 << tails.quantile_width << "um";
+  return 0;
+}
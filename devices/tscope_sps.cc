@@ -12,7 +12,10 @@
 #include "constants.h"
 #include "log.h"
 
-#include "/home/jens/CLICdpStyle.C"
+// Plot style, the path is configured with CLICDP_STYLE in CMake:
+#ifdef CLICDP_STYLE
+#include CLICDP_STYLE
+#endif
 
 using namespace std;
 using namespace gblsim;
@@ -20,7 +23,9 @@ using namespace unilog;
 
 int main(int argc, char* argv[]) {
 
+#ifdef CLICDP_STYLE
     CLICdpStyle();
+#endif
 
     /*
     * Telescope resolution simulation for the CLICdp Timepix3 telescope at the SPS H6B beam line
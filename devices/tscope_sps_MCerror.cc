@@ -8,14 +8,20 @@
 #include "TFile.h"
 #include "TRandom.h"
 #include "TRandom3.h"
+#include "TStyle.h"
 
 #include "assembly.h"
+#include "threadpool.h"
+#include "statistics.h"
 #include "propagate.h"
 #include "materials.h"
 #include "constants.h"
 #include "log.h"
 
-#include "/home/jens/CLICdpStyle.C"
+// Plot style, the path is configured with CLICDP_STYLE in CMake:
+#ifdef CLICDP_STYLE
+#include CLICDP_STYLE
+#endif
 
 using namespace std;
 using namespace gblsim;
@@ -23,7 +29,9 @@ using namespace unilog;
 
 int main(int argc, char* argv[]) {
 
+#ifdef CLICDP_STYLE
     CLICdpStyle();
+#endif
     gStyle->SetOptFit(1111);
 
     /*
@@ -34,6 +42,8 @@ int main(int argc, char* argv[]) {
 
 
     Log::ReportingLevel() = Log::FromString("INFO");
+    // Messages are logged from the worker threads:
+    SetLogOutput::Asynchronous() = true;
 
     int mode;
     if(argc == 1) {
@@ -137,8 +147,10 @@ int main(int argc, char* argv[]) {
     //----------------------------------------------------------------------------
     // Build the trajectory through the telescope device:
 
+    // All variations are drawn first, so the random sequence does not depend on the threads:
     TRandom3* rand = new TRandom3();
     // rand->SetSeed(33333);
+    std::vector<std::vector<plane>> variations;
     for(int it=0; it<1e4; it++) {
 
         // Prepare the DUT (no measurement, just scatterer
@@ -160,28 +172,51 @@ int main(int argc, char* argv[]) {
         std::vector<plane> planes = tpx3_tel;
         planes.emplace_back(dut);
 
-        // Build the telescope:
-        telescope mytel(planes, EBEAM);
+        variations.push_back(planes);
+    }
 
-        // Get the resolution at plane-vector position (x):
-        LOG(logRESULT) << "Track resolution at DUT in iteration it = " << it << ": " << mytel.getResolution(3) << "% X0";
-        hResolution->Fill(mytel.getResolution(3));
+    // Every worker builds the telescopes of every n-th variation and fills its own accumulators:
+    size_t workers = threadpool::global().size() + 1;
+    std::vector<double> resolutions(variations.size());
+    std::vector<moments> stats(workers);
+    std::vector<tdigest> quantiles(workers);
+    threadpool::global().parallel_for(workers, [&](size_t w) {
+        for(size_t it = w; it < variations.size(); it += workers) {
+            telescope mytel(variations.at(it), EBEAM);
+
+            // Get the resolution at plane-vector position (x):
+            resolutions.at(it) = mytel.getResolution(3);
+            LOG(logRESULT) << "Track resolution at DUT in iteration it = " << it << ": " << resolutions.at(it) << "% X0";
+            stats.at(w).fill(resolutions.at(it));
+            quantiles.at(w).fill(resolutions.at(it));
+        }
+    });
+    for(size_t w = 1; w < workers; w++) {
+        stats.front().add(stats.at(w));
+        quantiles.front().add(quantiles.at(w));
     }
 
-    LOG(logRESULT) << "Histgram has " << hResolution->GetEntries() << " entries.";
-    c1->cd();
-    hResolution->Draw();
-    double mean = hResolution->GetMean();
-    double sigma = hResolution->GetRMS();
+    // Unbinned Gaussian fit within 5 sigma around the mean instead of a fit to the binned histogram:
+    double mean = stats.front().mean();
+    double sigma = stats.front().sigma();
     std::cout << "Set range to " << mean-5*sigma << ", " << mean+5*sigma << std::endl;
-    hResolution->GetXaxis()->SetRangeUser(mean-5*sigma,mean+5*sigma);
+    gaussfit core(mean-5*sigma, mean+5*sigma);
+    for(auto resolution : resolutions) core.fill(resolution);
+    gaussfit::result fit = core.fit();
 
-    hResolution->Fit("gaus");
-    TF1* func = hResolution->GetFunction("gaus");
-    double fMean = func->GetParameter(1);
-    double fSigma = func->GetParameter(2);
+    std::cout << std::setprecision(4) << "Track pointing resolution (mean+/-sigma): " << fit.mean << "+/-" << fit.sigma << "um" << std::endl;
+    std::cout << std::setprecision(4) << "Central 68% of the resolutions: " << quantiles.front().quantile(0.16) << " - "
+              << quantiles.front().quantile(0.84) << "um" << std::endl;
 
-    std::cout << std::setprecision(4) << "Track pointing resolution (mean+/-sigma): " << fMean << "+/-" << fSigma << "um" << std::endl;
+    // The histogram is only filled for the plot, with the fitted Gaussian:
+    for(auto resolution : resolutions) hResolution->Fill(resolution);
+    LOG(logRESULT) << "Histgram has " << hResolution->GetEntries() << " entries.";
+    c1->cd();
+    hResolution->GetXaxis()->SetRangeUser(mean-5*sigma,mean+5*sigma);
+    hResolution->Draw();
+    TF1* func = new TF1("gaus", "gaus", mean-5*sigma, mean+5*sigma);
+    func->SetParameters(core.entries()*hResolution->GetBinWidth(1)/(std::sqrt(2*M_PI)*fit.sigma), fit.mean, fit.sigma);
+    func->Draw("same");
 
 
     if(mode == 1) {
@@ -15,22 +15,22 @@ using namespace gbl;
 
 plane plane::reference(double position)
 {
-  return plane(position, false, 0.0, false, {0.0, 0.0}, 0.0);
+  return plane(position, false, 0.0, false, {0.0, 0.0}, -1.);
 }
 
 plane plane::inactive(double position, double material)
 {
-  return plane(position, true, material, false, {0.0, 0.0}, 0.0);
+  return plane(position, true, material, false, {0.0, 0.0}, -1.);
 }
 
 plane plane::active(double position, double material, double resolution)
 {
-  return plane(position, true, material, true, {resolution, resolution}, 0.0);
+  return plane(position, true, material, true, {resolution, resolution}, -1.);
 }
 
 plane plane::active(double position, double material, std::pair<double, double> resolution)
 {
-  return plane(position, true, material, true, resolution, 0.0);
+  return plane(position, true, material, true, resolution, -1.);
 }
 
 plane plane::unknown(double position, double size)
@@ -67,117 +67,172 @@ plane::plane(double position, bool has_scatterer, bool has_measurement, double s
   m_resolution[1] = 0.0;
 } 
 
-plane::plane() : plane(0, false, 0, false, std::make_pair(0.0, 0.0), 0.0) {}
+plane::plane() : plane(0, false, 0, false, std::make_pair(0.0, 0.0), -1.) {}
+
+// The free kinks only regularize the fit and the prior must stay negligible against the
+// information from the measurements, also for the offset between the two kinks of thin unknown
+// scatterers. A prior of 1 noticeably constrained the kinks of thick unknown scatterers:
+const double gblsim::free_kink_precision = 1e-8;
+
+namespace {
+  // A point along the trajectory before it is converted into a GblPoint
+  struct element {
+    double position;
+    // Plane this element belongs to, -1 for volume scatterers
+    int plane;
+    // Whether the label of the plane points to this element
+    bool label;
+    // Whether this element is a free kink of an unknown scatterer
+    bool kink;
+    bool measurement;
+    Eigen::Vector2d resolution;
+    bool scatterer;
+    Eigen::Vector2d wscat;
+  };
+
+  element make_element(double position, int plane, bool label) {
+    element el;
+    el.position = position;
+    el.plane = plane;
+    el.label = label;
+    el.kink = false;
+    el.measurement = false;
+    el.resolution.setZero();
+    el.scatterer = false;
+    el.wscat.setZero();
+    return el;
+  }
+}
 
-telescope::telescope(std::vector<gblsim::plane> planes, double beam_energy, double material) :
+telescope::telescope(std::vector<gblsim::plane> planes, double beam_energy, double material, discretization policy) :
   m_volumeMaterial(material),
+  m_beamEnergy(beam_energy),
+  m_totalMaterialBudget(0),
+  m_discretizationError(0),
+  m_planes(),
   m_listOfPoints(),
   m_listOfLabels(),
-  m_parameter(5)
+  m_pointPositions(),
+  m_unknowns()
 {
   LOG(logINFO) << "Received " << planes.size() << " planes.";
 
-    // Make sure they are ordered in z by sorting the planes vector:
-  std::sort(planes.begin(),planes.end());
-  
-  double arclength = 0;
-  double oldpos = 0;
-  double arcDUT = -1.;
+  // Make sure they are ordered in z by sorting the planes vector, planes at equal positions
+  // keep their order:
+  std::stable_sort(planes.begin(),planes.end());
+  m_planes = planes;
 
   // Calculate the total material budget to correctly estimate the scattering:
   double total_materialbudget = getTotalMaterialBudget(planes);
-  
-  // Add first plane:
-  std::vector<plane>::iterator pl = planes.begin();
-  if(pl->m_measurement) {
-    m_listOfPoints.push_back(getPoint(pl->m_position,pl->m_resolution,getScatterer(beam_energy,pl->m_materialbudget,total_materialbudget)));
-    LOG(logDEBUG) << "Added plane at " << arclength << " (scatterer + measurement)";
-  }
-  else {
-    m_listOfPoints.push_back(getPoint(pl->m_position,getScatterer(beam_energy,pl->m_materialbudget,total_materialbudget)));
-    LOG(logDEBUG) << "Added plane at " << arclength << " (scatterer)";
-  }
-  oldpos = pl->m_position;
-  // Advance the iterator:
-  pl++;
-
-  // Store plane label:
-  m_listOfLabels.push_back(m_listOfPoints.size());
-
-  // All planes except first:
-  for(pl; pl != planes.end(); pl++) {
-
-    // Let's first add the air:
-    double plane_distance = pl->m_position - oldpos;
-    LOG(logDEBUG2) << "Distance to next plane: " << plane_distance;
-    double distance = 0;
-    double size;
-    
-    // Check if a volume scatterer with radiation length != 0 has been defined:
-    if(m_volumeMaterial > 0.0) {
-      // Propagate [mm] from 0 to 0.21 = 0.5 - 1/sqrt(12)
-      distance = 0.21 * plane_distance; arclength += distance;
-
-      // Add volume scatterer:
-      m_listOfPoints.push_back(getPoint(distance,getScatterer(beam_energy,0.5*plane_distance/m_volumeMaterial,total_materialbudget)));
-      LOG(logDEBUG3) << "Added volume scat at " << arclength;
-
-      // Propagate [mm] 0.58 = from 0.21 to 0.79 = 0.5 + 1/sqrt(12)
-      distance = 0.58 * plane_distance; arclength += distance;
-
-      // Factor 0.5 for the volume as it is split into two scatterers:
-      m_listOfPoints.push_back(getPoint(distance,getScatterer(beam_energy,0.5*plane_distance/m_volumeMaterial,total_materialbudget)));
-      LOG(logDEBUG3) << "Added volume scat at " << arclength;
-
-      // Propagate [mm] from 0 to 0.21 = 0.5 - 1/sqrt(12)
-      distance = 0.21 * plane_distance; arclength += distance;
+  m_totalMaterialBudget = total_materialbudget;
+
+  // Decide how many thin scatterers are needed for each volume:
+  std::vector<unsigned int> volume_scatterers = discretize(planes, policy.tolerance);
+
+  // Collect all points along the trajectory:
+  std::vector<element> elements;
+  for(size_t p = 0; p < planes.size(); p++) {
+    const plane& pl = planes.at(p);
+
+    // Let's first add the air between this and the previous plane:
+    if(p > 0 && volume_scatterers.at(p) > 0) {
+      double oldpos = planes.at(p-1).m_position;
+      double plane_distance = pl.m_position - oldpos;
+      LOG(logDEBUG2) << "Distance to next plane: " << plane_distance;
+
+      // Two scatterers at 0.21 = 0.5 - 1/sqrt(12) and 0.79 = 0.5 + 1/sqrt(12) of the distance,
+      // factor 0.5 for the volume as it is split into two scatterers. A merged volume is placed
+      // as single scatterer in the centre:
+      std::vector<double> fractions = (volume_scatterers.at(p) == 2 ? std::vector<double>{0.21, 0.79} : std::vector<double>{0.5});
+      for(double fraction : fractions) {
+        element scat = make_element(oldpos + fraction*plane_distance, -1, false);
+        scat.scatterer = true;
+        scat.wscat = getScatterer(beam_energy,plane_distance/m_volumeMaterial/fractions.size(),total_materialbudget);
+        elements.push_back(scat);
+        LOG(logDEBUG3) << "Added volume scat at " << scat.position;
+      }
       LOG(logDEBUG) << "Added volume scatterers.";
     }
-    else {
-      // No volume scatterer defined (vacuum), simply propagate to the next plane:
-      distance = plane_distance;
-    }
-    
-    if(pl->m_measurement) {
-      gbl::GblPoint point(getPoint(distance,pl->m_resolution,getScatterer(beam_energy,pl->m_materialbudget,total_materialbudget)));
-      //m_listOfPoints.push_back(getPoint(distance,pl->m_resolution,getScatterer(beam_energy,pl->m_materialbudget,total_materialbudget)));
-      Eigen::Matrix<double, 2, 3> addDer;
-      addDer.setZero();
-      if(arcDUT > 0) {
-        addDer(0,0) = (arclength - (arcDUT + size/sqrt(12))); // First scatterer in target
-	addDer(1,1) = (arclength - (arcDUT + size/sqrt(12))); //
-	addDer(0,2) = (arclength - (arcDUT - size/sqrt(12))); // second scatterer in target
-	addDer(1,3) = (arclength - (arcDUT - size/sqrt(12))); //
-	LOG(logDEBUG) << " size = "        <<  size
-		      << " lever arm left DUT-point = "      << (arclength - (arcDUT + size/sqrt(12))) 
-		      << " and lever arm right DUT-point = " << (arclength - (arcDUT - size/sqrt(12)));
-
-        point.addLocals(addDer); 
+
+    if(!pl.m_measurement && pl.m_size >= 0.0) {
+      // Unknown scatterers are described by free kinks at 0.5 -+ 1/sqrt(12) of their size:
+      double offset = pl.m_size/sqrt(12);
+      LOG(logINFO) << " adding unknown scatterer at " << pl.m_position << " with size " << pl.m_size;
+      if(offset > 0.0) {
+        for(double position : {pl.m_position - offset, pl.m_position + offset}) {
+          element kink = make_element(position, p, false);
+          kink.kink = true;
+          kink.scatterer = true;
+          kink.wscat << free_kink_precision, free_kink_precision;
+          elements.push_back(kink);
+        }
+        // Reference point in the centre of the unknown scatterer:
+        elements.push_back(make_element(pl.m_position, p, true));
       }
-      m_listOfPoints.push_back(point);
-      LOG(logDEBUG) << "Added plane at " << arclength << " (scatterer + measurement)";
-      if(arcDUT > 0) LOG(logDEBUG) << "                        + local derivative)";
+      else {
+        element kink = make_element(pl.m_position, p, true);
+        kink.kink = true;
+        kink.scatterer = true;
+        kink.wscat << free_kink_precision, free_kink_precision;
+        elements.push_back(kink);
+      }
+      continue;
+    }
+
+    element el = make_element(pl.m_position, p, true);
+    el.measurement = pl.m_measurement;
+    el.resolution = pl.m_resolution;
+    // Planes without material (reference planes) do not scatter:
+    el.scatterer = (pl.m_materialbudget > 0.0);
+    if(el.scatterer) {
+      el.wscat = getScatterer(beam_energy,pl.m_materialbudget,total_materialbudget);
+    }
+    elements.push_back(el);
+  }
+
+  // Unknown scatterers might extend beyond neighbouring volume scatterers:
+  std::stable_sort(elements.begin(), elements.end(),
+                   [](const element& a, const element& b) { return a.position < b.position; });
+
+  // Convert into GBL points and store the plane labels:
+  m_listOfLabels.resize(planes.size());
+  double oldpos = elements.front().position;
+  for(const auto& el : elements) {
+    double distance = el.position - oldpos;
+    if(el.measurement && el.scatterer) {
+      m_listOfPoints.push_back(getPoint(distance,el.resolution,el.wscat));
+      LOG(logDEBUG) << "Added plane at " << el.position << " (scatterer + measurement)";
     }
-    else if (!pl->m_measurement && pl->m_size < 0.0) {
-      m_listOfPoints.push_back(getPoint(distance,getScatterer(beam_energy,pl->m_materialbudget,total_materialbudget)));
-      LOG(logDEBUG) << "Added plane at " << arclength << " (scatterer)";
+    else if(el.measurement) {
+      m_listOfPoints.push_back(getMeasurement(distance,el.resolution));
+      LOG(logDEBUG) << "Added plane at " << el.position << " (measurement)";
     }
-    else if ( pl->m_size >= 0.0 && arcDUT < 0) {
-      LOG(logINFO)<< " adding unknown scatterer at " << arclength << ". Adding local derivatives for subsequent measurement points!! ";
-      arcDUT = arclength;
-      size = pl->m_size;
-      m_parameter+=4;
+    else if(el.scatterer) {
+      m_listOfPoints.push_back(getPoint(distance,el.wscat));
+      if(el.plane >= 0) {
+        LOG(logDEBUG) << "Added plane at " << el.position << (el.kink ? " (free kink)" : " (scatterer)");
+      }
     }
-    else if ( pl->m_size >= 0.0 && arcDUT > 0) {
-      LOG(logERROR) << " ___________________________________________________________________________________";
-      LOG(logERROR) << " Software only supports one unknown scatterer! Ommitting further unknown scatterers!";
-      LOG(logERROR) << " ___________________________________________________________________________________";
+    else {
+      m_listOfPoints.push_back(getMarker(distance));
+      LOG(logDEBUG) << "Added plane at " << el.position << " (reference)";
     }
-    // Update position of previous plane:
-    oldpos = pl->m_position;
+    m_pointPositions.push_back(el.position);
+    oldpos = el.position;
+
     // Store plane label:
-    m_listOfLabels.push_back(m_listOfPoints.size());
+    if(el.label) {
+      m_listOfLabels.at(el.plane) = m_listOfPoints.size();
+    }
 
+    // Remember the free kinks of unknown scatterers:
+    if(el.kink) {
+      if(m_unknowns.empty() || m_unknowns.back().plane != el.plane) {
+        m_unknowns.push_back(unknown());
+        m_unknowns.back().plane = el.plane;
+      }
+      m_unknowns.back().points.push_back(m_listOfPoints.size() - 1);
+    }
   }
 
   LOG(logDEBUG) << "Finished building trajectory.";
@@ -205,6 +260,40 @@ double telescope::getTotalMaterialBudget(const std::vector<gblsim::plane>& plane
   return total_materialbudget;
 }
 
+std::vector<unsigned int> telescope::discretize(const std::vector<gblsim::plane>& planes, double tolerance) {
+
+  std::vector<unsigned int> scatterers(planes.size(), (m_volumeMaterial > 0.0 ? 2 : 0));
+  scatterers.front() = 0;
+  if(m_volumeMaterial <= 0.0 || tolerance <= 0.0) {
+    return scatterers;
+  }
+
+  // Fraction of the total scattering variance from each volume, which is independent of the beam energy:
+  std::vector<std::pair<double,size_t>> weights;
+  for(size_t p = 1; p < planes.size(); p++) {
+    double distance = planes.at(p).m_position - planes.at(p-1).m_position;
+    weights.push_back(std::make_pair(distance/m_volumeMaterial/m_totalMaterialBudget, p));
+  }
+  std::sort(weights.begin(), weights.end());
+
+  // Merging saves one point for a quarter of the volume's contribution, prefer it over dropping:
+  double budget = tolerance;
+  for(const auto& w : weights) {
+    if(0.25*w.first > budget) break;
+    budget -= 0.25*w.first;
+    scatterers.at(w.second) = 1;
+  }
+  for(const auto& w : weights) {
+    if(scatterers.at(w.second) != 1 || 0.75*w.first > budget) break;
+    budget -= 0.75*w.first;
+    scatterers.at(w.second) = 0;
+  }
+  m_discretizationError = tolerance - budget;
+
+  LOG(logDEBUG) << "Volume discretization neglects a fraction of " << m_discretizationError << " of the scattering";
+  return scatterers;
+}
+
 GblTrajectory telescope::getTrajectory() const {
 
   GblTrajectory traj(m_listOfPoints, 0);
@@ -212,9 +301,14 @@ GblTrajectory telescope::getTrajectory() const {
   return traj;
 }
 
-std::pair<double,double> telescope::getResolutionXY(int plane) const {
+GblTrajectory telescope::fitTrajectory() const {
+  return fitTrajectory(m_listOfPoints);
+}
+
+GblTrajectory telescope::fitTrajectory(const std::vector<gbl::GblPoint>& points) const {
 
-  GblTrajectory tr = getTrajectory();
+  GblTrajectory tr(points, 0);
+  IFLOG(logDEBUG2) { tr.printPoints(); }
 
   double c2, lw;
   int ndf;
@@ -222,9 +316,15 @@ std::pair<double,double> telescope::getResolutionXY(int plane) const {
   tr.fit(c2, ndf, lw);
   LOG(logDEBUG2) << " Fit: Chi2=" << c2 << ", Ndf=" << ndf << ", lostWeight=" << lw;
   IFLOG(logDEBUG2) { tr.printTrajectory(); }
+  return tr;
+}
+
+std::pair<double,double> telescope::getResolutionXY(int plane) const {
+
+  GblTrajectory tr = fitTrajectory();
 
-  Eigen::VectorXd aCorr(m_parameter);
-  Eigen::MatrixXd aCov(m_parameter, m_parameter);
+  Eigen::VectorXd aCorr(5);
+  Eigen::MatrixXd aCov(5, 5);
 
   // Get resolution at position of the DUT:
   if(plane < m_listOfLabels.size()) {
@@ -239,30 +339,100 @@ double telescope::getResolution(int plane) const {
 
 std::pair<double,double> telescope::getKinkResolutionXY(int plane) const {
 
-  GblTrajectory tr = getTrajectory();
+  std::vector<unknown>::const_iterator scatterer = m_unknowns.begin();
+  while(scatterer != m_unknowns.end() && scatterer->plane != plane) scatterer++;
+  if(scatterer == m_unknowns.end()) {
+    LOG(logERROR) << "Plane " << plane << " is not an unknown scatterer, cannot calculate kink resolution.";
+    return std::make_pair(0.0, 0.0);
+  }
 
-  double c2, lw;
-  unsigned int ndata = 2;
-  int ndf;
+  // Only the requested unknown scatterer is described by local parameters, its kinks are replaced
+  // by the corresponding derivatives of all subsequent measurements. All other unknown scatterers
+  // remain free kinks within the trajectory, such that the size of the problem does not grow:
+  std::vector<gbl::GblPoint> points = m_listOfPoints;
+  unsigned int nlocals = 2*scatterer->points.size();
+  for(auto point : scatterer->points) {
+    points.at(point) = getMarker(point > 0 ? m_pointPositions.at(point) - m_pointPositions.at(point-1) : 0.);
+  }
 
-  tr.fit(c2, ndf, lw);
-  LOG(logDEBUG2) << " Fit: Chi2=" << c2 << ", Ndf=" << ndf << ", lostWeight=" << lw;
-  IFLOG(logDEBUG2) { tr.printTrajectory(); }
+  for(size_t p = 0; p < m_planes.size(); p++) {
+    if(!m_planes.at(p).m_measurement) continue;
+    unsigned int point = m_listOfLabels.at(p) - 1;
+
+    Eigen::MatrixXd addDer = Eigen::MatrixXd::Zero(2, nlocals);
+    bool downstream = false;
+    for(size_t k = 0; k < scatterer->points.size(); k++) {
+      double lever = m_pointPositions.at(point) - m_pointPositions.at(scatterer->points.at(k));
+      if(lever <= 0.0) continue;
+      addDer(0,2*k) = lever;
+      addDer(1,2*k+1) = lever;
+      downstream = true;
+    }
+    if(downstream) {
+      LOG(logDEBUG2) << "Adding local derivatives to plane " << p << ":" << std::endl << addDer;
+      points.at(point).addLocals(addDer);
+    }
+  }
 
-  Eigen::VectorXd aCorr(m_parameter);
-  Eigen::MatrixXd aCov(m_parameter, m_parameter);
+  GblTrajectory tr = fitTrajectory(points);
 
-  // Get resolution at position of the DUT:
-  if(plane < m_listOfLabels.size()) {
-    tr.getResults(m_listOfLabels.at(plane), aCorr, aCov);
+  Eigen::VectorXd aCorr(5 + nlocals);
+  Eigen::MatrixXd aCov(5 + nlocals, 5 + nlocals);
+  tr.getResults(m_listOfLabels.at(plane), aCorr, aCov);
+
+  // The kink is the sum of all kinks of the unknown scatterer:
+  double kinkx = 0, kinky = 0;
+  for(unsigned int i = 0; i < nlocals; i += 2) {
+    for(unsigned int j = 0; j < nlocals; j += 2) {
+      kinkx += aCov(5+i,5+j);
+      kinky += aCov(6+i,6+j);
+    }
   }
-  return std::make_pair( sqrt(aCov(5,5) + aCov(7,7) + 2*aCov(5,7))*1E6, sqrt( sqrt(aCov(6,6) + aCov(8,8) + 2*aCov(6,8) )*1E6) );
+  return std::make_pair(sqrt(kinkx)*1E6, sqrt(kinky)*1E6);
 }
 
 double telescope::getKinkResolution(int plane) const {
   return std::get<0>(getKinkResolutionXY(plane));
 }
 
+std::vector<residual> telescope::getResidualWidths() const {
+
+  GblTrajectory tr = fitTrajectory();
+  std::vector<residual> residuals;
+
+  Eigen::VectorXd aCorr(5);
+  Eigen::MatrixXd aCov(5, 5);
+
+  for(size_t p = 0; p < m_planes.size(); p++) {
+    if(!m_planes.at(p).m_measurement) continue;
+
+    // Track covariance in x/y at the plane from the fit including its measurement:
+    tr.getResults(m_listOfLabels.at(p), aCorr, aCov);
+    Eigen::Matrix2d trackCov = aCov.block<2,2>(3,3);
+
+    // Measurement covariance of the plane:
+    Eigen::Matrix2d measCov = Eigen::Matrix2d::Zero();
+    measCov(0,0) = m_planes.at(p).m_resolution[0]*m_planes.at(p).m_resolution[0];
+    measCov(1,1) = m_planes.at(p).m_resolution[1]*m_planes.at(p).m_resolution[1];
+
+    // Biased residuals are anti-correlated with the track, unbiased ones are not:
+    Eigen::Matrix2d biased = measCov - trackCov;
+
+    // Remove the plane's measurement from the track by downdating its information:
+    Eigen::Matrix2d unbiasedCov = (trackCov.inverse() - measCov.inverse()).inverse();
+    Eigen::Matrix2d unbiased = measCov + unbiasedCov;
+
+    residual res;
+    res.plane = p;
+    res.biased = std::make_pair(sqrt(biased(0,0))*1E3, sqrt(biased(1,1))*1E3);
+    res.unbiased = std::make_pair(sqrt(unbiased(0,0))*1E3, sqrt(unbiased(1,1))*1E3);
+    LOG(logDEBUG) << "Plane " << p << " biased residual width " << std::get<0>(res.biased)
+                  << "um, unbiased residual width " << std::get<0>(res.unbiased) << "um";
+    residuals.push_back(res);
+  }
+  return residuals;
+}
+
 void telescope::printLabels() const {
 
   for(size_t l = 0; l < m_listOfLabels.size(); l++) {
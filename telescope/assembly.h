@@ -1,9 +1,15 @@
+#ifndef ASSEMBLY_H
+#define ASSEMBLY_H
+
 #include <utility>
 
 #include "GblTrajectory.h"
 #include "materials.h"
 
 namespace gblsim {
+  // Precision of the free kinks of unknown scatterers [1/rad^2], shared with the native track model
+  extern const double free_kink_precision;
+
   class plane {
   public:
     // Virtual reference plane w/o material or measurement
@@ -22,6 +28,14 @@ namespace gblsim {
     plane(double position, bool scatterer, bool measurement, double size);
 
     double position() const { return m_position; }
+    double material() const { return m_materialbudget; }
+    bool measurement() const { return m_measurement; }
+    std::pair<double,double> resolution() const { return std::make_pair(m_resolution[0], m_resolution[1]); }
+    // Size of an unknown scatterer, negative for all other planes
+    double size() const { return m_size; }
+    bool isUnknown() const { return !m_measurement && m_size >= 0.0; }
+    void setPosition(double position) { m_position = position; }
+    void setMaterial(double material) { m_materialbudget = material; }
 
     bool operator < (const plane& pl) const {
         return (m_position < pl.m_position);
@@ -50,9 +64,32 @@ namespace gblsim {
     friend class telescope;
   };
 
+  // Predicted residual widths at a measurement plane, in [um]:
+  struct residual {
+    // Index of the plane in the z-ordered plane vector
+    int plane;
+    // Residual width with the plane included in the track fit
+    std::pair<double,double> biased;
+    // Residual width with the plane excluded from the track fit
+    std::pair<double,double> unbiased;
+  };
+
+  // Policy for the discretization of the volume between planes into thin scatterers.
+  // Each volume is by default replaced by two scatterers at 0.5 -+ 1/sqrt(12) of its length, which
+  // reproduces the scattering of the full volume exactly at the planes. Volumes can instead be merged
+  // into a single central scatterer (neglecting a quarter of their contribution to the position
+  // variance) or be dropped, as long as the total neglected fraction of the scattering stays below
+  // the tolerance. The smallest volume contributions are simplified first.
+  struct discretization {
+    discretization(double tolerance = 0.) : tolerance(tolerance) {}
+    // Maximum fraction of the total scattering variance which may be neglected
+    double tolerance;
+  };
+
   class telescope {
   public:
-    telescope(std::vector<gblsim::plane> planes, double beam_energy, double material = X0_Air);
+    telescope(std::vector<gblsim::plane> planes, double beam_energy, double material = X0_Air,
+              discretization policy = discretization());
 
     // Return the trajectory
     gbl::GblTrajectory getTrajectory() const;
@@ -67,14 +104,50 @@ namespace gblsim {
     // Return the kink resolution in both dimensions on the given plane
     std::pair<double,double> getKinkResolutionXY(int plane) const;
 
+    // Return biased and unbiased residual widths for all measurement planes from a single fit
+    std::vector<residual> getResidualWidths() const;
+
+    // Return the beam energy in [GeV]
+    double getBeamEnergy() const { return m_beamEnergy; }
+    // Return the total material budget x/X0 in the particle path
+    double getTotalMaterialBudget() const { return m_totalMaterialBudget; }
+    // Return the fraction of the scattering variance neglected by the volume discretization
+    double getDiscretizationError() const { return m_discretizationError; }
+    // Return the number of points along the trajectory
+    size_t getNumberOfPoints() const { return m_listOfPoints.size(); }
+    // Return the points of the trajectory, their positions and the point of the given plane
+    const std::vector<gbl::GblPoint>& getPoints() const { return m_listOfPoints; }
+    const std::vector<double>& getPointPositions() const { return m_pointPositions; }
+    int getPointIndex(int plane) const { return m_listOfLabels.at(plane) - 1; }
+
     void printLabels() const;
   private:
     // Radiationlength of the material of the surrounding volume, defaults to dry air:
     double m_volumeMaterial;
-    
+    double m_beamEnergy;
+    double m_totalMaterialBudget;
+    double m_discretizationError;
+
     double getTotalMaterialBudget(const std::vector<plane>& planes) const;
+    // Number of thin scatterers representing the volume in front of each plane
+    std::vector<unsigned int> discretize(const std::vector<plane>& planes, double tolerance);
+    // Build and fit the trajectory
+    gbl::GblTrajectory fitTrajectory() const;
+    gbl::GblTrajectory fitTrajectory(const std::vector<gbl::GblPoint>& points) const;
+
+    std::vector<plane> m_planes;
     std::vector<gbl::GblPoint> m_listOfPoints;
     std::vector<int> m_listOfLabels;
-    unsigned int m_parameter;
+    // Position of every point along the trajectory
+    std::vector<double> m_pointPositions;
+
+    // Unknown scatterers and the indices of the points holding their free kinks
+    struct unknown {
+      int plane;
+      std::vector<unsigned int> points;
+    };
+    std::vector<unknown> m_unknowns;
   };
 }
+
+#endif /* ASSEMBLY_H */
@@ -0,0 +1,246 @@
+// Persistent cache of fitted results
+
+#include "cache.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <thread>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+using namespace gblsim;
+using namespace unilog;
+
+namespace {
+  // Entry file identifier and format version:
+  const char cache_magic[] = "GBLCACHE";
+  const uint32_t cache_format = 1;
+  const char cache_suffix[] = ".res";
+
+  // Exact representation of a double:
+  std::string exact(double value) {
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%a", value);
+    return buffer;
+  }
+
+  bool isEntry(const std::string& name) {
+    size_t n = std::strlen(cache_suffix);
+    return name.size() > n && name.compare(name.size() - n, n, cache_suffix) == 0;
+  }
+}
+
+resultcache::resultcache(const std::string& directory, uint64_t max_bytes) :
+  m_directory(directory),
+  m_maxBytes(max_bytes),
+  m_good(true),
+  m_mutex(),
+  m_estimate(std::numeric_limits<uint64_t>::max()),
+  m_hits(0),
+  m_misses(0),
+  m_stores(0),
+  m_evictions(0)
+{
+  if(mkdir(m_directory.c_str(), 0755) != 0 && errno != EEXIST) {
+    LOG(logERROR) << "Cannot create cache directory " << m_directory << ", caching disabled.";
+    m_good = false;
+  }
+}
+
+std::string resultcache::describe(const std::vector<plane>& planes, double beam_energy, double material, const std::string& backend) {
+  std::vector<plane> sorted = planes;
+  std::stable_sort(sorted.begin(), sorted.end());
+
+  std::ostringstream out;
+  out << "version " << results_version << " backend " << backend << " beam " << exact(beam_energy)
+      << " volume " << exact(material) << "\n";
+  for(const auto& pl : sorted) {
+    out << exact(pl.position()) << " " << exact(pl.material()) << " " << pl.measurement() << " "
+        << exact(pl.resolution().first) << " " << exact(pl.resolution().second) << " " << exact(pl.size()) << "\n";
+  }
+  return out.str();
+}
+
+uint64_t resultcache::hash(const std::string& description) {
+  // 64 bit FNV-1a:
+  uint64_t h = 14695981039346656037ull;
+  for(unsigned char c : description) {
+    h ^= c;
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+std::string resultcache::getPath(const std::string& description) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash(description)));
+  return m_directory + "/" + name + cache_suffix;
+}
+
+bool resultcache::lookup(const std::vector<plane>& planes, double beam_energy, double material, const std::string& backend,
+                         std::vector<planeresult>& results) {
+  if(!m_good) return false;
+  std::string description = describe(planes, beam_energy, material, backend);
+  std::string path = getPath(description);
+
+  std::ifstream in(path.c_str(), std::ios::binary);
+  char magic[8];
+  uint32_t format = 0;
+  uint64_t length = 0, count = 0;
+  bool valid = in.read(magic, 8) && std::memcmp(magic, cache_magic, 8) == 0
+    && in.read(reinterpret_cast<char*>(&format), sizeof(format)) && format == cache_format
+    && in.read(reinterpret_cast<char*>(&length), sizeof(length)) && length == description.size();
+  if(valid) {
+    std::string stored(length, '\0');
+    valid = in.read(&stored[0], length) && stored == description
+      && in.read(reinterpret_cast<char*>(&count), sizeof(count)) && count == planes.size();
+  }
+  if(valid) {
+    std::vector<planeresult> entry(count);
+    valid = static_cast<bool>(in.read(reinterpret_cast<char*>(entry.data()), count*sizeof(planeresult)));
+    if(valid) results.swap(entry);
+  }
+
+  if(!valid) {
+    m_misses++;
+    return false;
+  }
+  // Mark as recently used:
+  utime(path.c_str(), nullptr);
+  m_hits++;
+  return true;
+}
+
+void resultcache::store(const std::vector<plane>& planes, double beam_energy, double material, const std::string& backend,
+                        const std::vector<planeresult>& results) {
+  if(!m_good || results.size() != planes.size()) return;
+  std::string description = describe(planes, beam_energy, material, backend);
+  std::string path = getPath(description);
+
+  // Write under a name unique to this process and thread, then move into place atomically:
+  std::ostringstream temporary;
+  temporary << m_directory << "/.tmp." << getpid() << "." << std::this_thread::get_id();
+  {
+    std::ofstream out(temporary.str().c_str(), std::ios::binary);
+    uint64_t length = description.size(), count = results.size();
+    out.write(cache_magic, 8);
+    out.write(reinterpret_cast<const char*>(&cache_format), sizeof(cache_format));
+    out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    out.write(description.data(), length);
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    out.write(reinterpret_cast<const char*>(results.data()), count*sizeof(planeresult));
+    if(!out) {
+      LOG(logWARNING) << "Cannot write cache entry " << temporary.str();
+      std::remove(temporary.str().c_str());
+      return;
+    }
+  }
+  if(std::rename(temporary.str().c_str(), path.c_str()) != 0) {
+    std::remove(temporary.str().c_str());
+    return;
+  }
+  m_stores++;
+
+  if(m_maxBytes == 0) return;
+  uint64_t size = 8 + sizeof(cache_format) + 16 + description.size() + results.size()*sizeof(planeresult);
+  bool full;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_estimate = (m_estimate == std::numeric_limits<uint64_t>::max() ? m_maxBytes + 1 : m_estimate + size);
+    full = (m_estimate > m_maxBytes);
+  }
+  if(full) evict();
+}
+
+void resultcache::evict() {
+  std::lock_guard<std::mutex> guard(m_mutex);
+
+  // One process at a time:
+  std::string lockfile = m_directory + "/.lock";
+  int fd = open(lockfile.c_str(), O_CREAT | O_RDWR, 0644);
+  if(fd < 0) return;
+  flock(fd, LOCK_EX);
+
+  struct entry {
+    std::string path;
+    uint64_t size;
+    time_t used;
+  };
+  std::vector<entry> entries;
+  uint64_t total = 0;
+  DIR* dir = opendir(m_directory.c_str());
+  if(dir) {
+    while(struct dirent* file = readdir(dir)) {
+      std::string name = file->d_name;
+      if(!isEntry(name)) continue;
+      struct stat info;
+      std::string path = m_directory + "/" + name;
+      if(stat(path.c_str(), &info) != 0) continue;
+      entries.push_back(entry{path, static_cast<uint64_t>(info.st_size), info.st_mtime});
+      total += info.st_size;
+    }
+    closedir(dir);
+  }
+
+  // Remove the least recently used entries until 90% of the limit is reached:
+  std::sort(entries.begin(), entries.end(), [](const entry& a, const entry& b) { return a.used < b.used; });
+  for(const auto& e : entries) {
+    if(total <= m_maxBytes*9/10) break;
+    if(std::remove(e.path.c_str()) == 0) {
+      m_evictions++;
+      total -= e.size;
+    }
+  }
+  m_estimate = total;
+
+  flock(fd, LOCK_UN);
+  close(fd);
+  LOG(logDEBUG) << "Cache " << m_directory << " holds " << total << " bytes after eviction";
+}
+
+std::vector<planeresult> gblsim::fitPlanes(const std::vector<plane>& planes, double beam_energy, double material) {
+  std::vector<plane> sorted = planes;
+  std::stable_sort(sorted.begin(), sorted.end());
+  telescope tel(sorted, beam_energy, material);
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  std::vector<planeresult> results(sorted.size(), planeresult{std::make_pair(nan, nan), std::make_pair(nan, nan),
+                                                              std::make_pair(nan, nan), std::make_pair(nan, nan)});
+  for(size_t p = 0; p < sorted.size(); p++) {
+    results[p].resolution = tel.getResolutionXY(p);
+    if(sorted[p].isUnknown()) results[p].kink = tel.getKinkResolutionXY(p);
+  }
+  for(const auto& r : tel.getResidualWidths()) {
+    results.at(r.plane).biased = r.biased;
+    results.at(r.plane).unbiased = r.unbiased;
+  }
+  return results;
+}
+
+std::vector<planeresult> resultcache::evaluate(const std::vector<plane>& planes, double beam_energy, double material) {
+  std::vector<planeresult> results;
+  if(lookup(planes, beam_energy, material, "gbl", results)) return results;
+  results = fitPlanes(planes, beam_energy, material);
+  store(planes, beam_energy, material, "gbl", results);
+  return results;
+}
+
+cachestatistics resultcache::getStatistics() const {
+  cachestatistics stats;
+  stats.hits = m_hits;
+  stats.misses = m_misses;
+  stats.stores = m_stores;
+  stats.evictions = m_evictions;
+  return stats;
+}
@@ -0,0 +1,90 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "assembly.h"
+
+namespace gblsim {
+
+  // Version of the physics and results of the library, part of every cache key. Increase it
+  // whenever a change alters results, which invalidates all cached entries.
+  const unsigned int results_version = 1;
+
+  // Results of one plane in [um] and [urad], NaN where not defined for the plane
+  struct planeresult {
+    std::pair<double,double> resolution;
+    // Only for unknown scatterers:
+    std::pair<double,double> kink;
+    // Only for measurement planes:
+    std::pair<double,double> biased;
+    std::pair<double,double> unbiased;
+  };
+
+  // Fit the telescope and return the results of all planes in z order
+  std::vector<planeresult> fitPlanes(const std::vector<plane>& planes, double beam_energy, double material = X0_Air);
+
+  // Hit and miss counters of this process
+  struct cachestatistics {
+    size_t hits;
+    size_t misses;
+    size_t stores;
+    size_t evictions;
+  };
+
+  // Persistent on-disk cache of fitted per-plane results.
+  //
+  // Entries are addressed by a hash of the canonical description of a geometry: planes sorted in
+  // z, beam energy, volume material, backend name and results version, with all numbers written
+  // exactly. The description is stored in the entry and compared on lookup, so hash collisions
+  // are misses. Every entry is one file written under a temporary name and renamed into place,
+  // so any number of processes on one machine can share a directory without locking for reads
+  // and writes. When the directory grows beyond its size limit, the least recently used entries
+  // are removed, serialized between processes with a lock file.
+  class resultcache {
+  public:
+    // Cache in the given directory, which is created if needed. A limit of zero disables eviction.
+    resultcache(const std::string& directory, uint64_t max_bytes = 1ull << 30);
+
+    // Results for all planes in z order, from the cache or fitted with the telescope class
+    std::vector<planeresult> evaluate(const std::vector<plane>& planes, double beam_energy, double material = X0_Air);
+
+    // Direct access for other backends, results are in z order of the planes
+    bool lookup(const std::vector<plane>& planes, double beam_energy, double material, const std::string& backend,
+                std::vector<planeresult>& results);
+    void store(const std::vector<plane>& planes, double beam_energy, double material, const std::string& backend,
+               const std::vector<planeresult>& results);
+
+    // Canonical description and its hash
+    static std::string describe(const std::vector<plane>& planes, double beam_energy, double material, const std::string& backend);
+    static uint64_t hash(const std::string& description);
+
+    cachestatistics getStatistics() const;
+
+  private:
+    std::string getPath(const std::string& description) const;
+    // Remove least recently used entries until the directory is below the limit
+    void evict();
+
+    std::string m_directory;
+    uint64_t m_maxBytes;
+    bool m_good;
+
+    // Size of the directory at the last scan plus everything written since:
+    std::mutex m_mutex;
+    uint64_t m_estimate;
+
+    std::atomic<size_t> m_hits;
+    std::atomic<size_t> m_misses;
+    std::atomic<size_t> m_stores;
+    std::atomic<size_t> m_evictions;
+  };
+
+}
+
+#endif /* CACHE_H */
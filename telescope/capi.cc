@@ -0,0 +1,308 @@
+// C interface with handle-based evaluation
+
+#include "capi.h"
+#include "assembly.h"
+#include "threadpool.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace gblsim;
+using namespace unilog;
+
+namespace {
+  // Working memory of one evaluation, kept between calls
+  struct scratch {
+    std::vector<plane> planes;
+    // The planes in z order, as the telescope orders them:
+    std::vector<plane> sorted;
+    // Position of every plane in z order:
+    std::vector<size_t> order;
+    std::vector<size_t> rank;
+  };
+
+  bool isValid(double value) { return std::isfinite(value); }
+}
+
+struct gblsim_telescope {
+  std::vector<plane> planes;
+  double beam_energy;
+  double volume;
+  // One slot per thread taking part in batch evaluations, the first one for single evaluations:
+  std::vector<scratch> slots;
+};
+
+namespace {
+  void prepare(scratch& s, const std::vector<plane>& planes) {
+    s.planes = planes;
+    s.sorted.resize(planes.size());
+    s.order.resize(planes.size());
+    s.rank.resize(planes.size());
+  }
+
+  // Rank of the planes in z. Insertion sort, which does not allocate and is fast for the nearly
+  // ordered planes of a telescope; equal positions keep their order. The telescope is built from
+  // the sorted planes, so its own stable sort keeps this order and the ranks refer to its planes.
+  void sortPlanes(scratch& s) {
+    for(size_t i = 0; i < s.order.size(); i++) {
+      size_t j = i;
+      for(; j > 0 && s.planes[i] < s.planes[s.order[j-1]]; j--) s.order[j] = s.order[j-1];
+      s.order[j] = i;
+    }
+    for(size_t k = 0; k < s.order.size(); k++) {
+      s.rank[s.order[k]] = k;
+      s.sorted[k] = s.planes[s.order[k]];
+    }
+  }
+
+  // Exceptions must not unwind into C callers:
+  int internalError(const char* function) {
+    try {
+      throw;
+    }
+    catch(const std::exception& e) {
+      LOG(logERROR) << function << ": " << e.what();
+    }
+    catch(...) {
+      LOG(logERROR) << function << ": unknown exception";
+    }
+    return GBLSIM_INTERNAL_ERROR;
+  }
+
+  plane withResolution(const plane& pl, double resolution_x, double resolution_y) {
+    return plane::active(pl.position(), pl.material(), std::make_pair(resolution_x, resolution_y));
+  }
+}
+
+int gblsim_abi_version(void) {
+  return GBLSIM_ABI_VERSION;
+}
+
+const char* gblsim_status_string(int status) {
+  switch(status) {
+  case GBLSIM_OK: return "ok";
+  case GBLSIM_INVALID_HANDLE: return "invalid handle";
+  case GBLSIM_INVALID_ARGUMENT: return "invalid argument";
+  case GBLSIM_INVALID_INDEX: return "plane index out of range";
+  case GBLSIM_NOT_UNKNOWN: return "plane is not an unknown scatterer";
+  case GBLSIM_INTERNAL_ERROR: return "internal error";
+  default: return "unknown status";
+  }
+}
+
+void gblsim_set_log_level(const char* level) {
+  try {
+    if(level) Log::ReportingLevel() = Log::FromString(std::string(level));
+  }
+  catch(...) {
+    internalError(__func__);
+  }
+}
+
+gblsim_telescope* gblsim_create(size_t n, const int* types, const double* z, const double* material,
+                                const double* resolution_x, const double* resolution_y, const double* size,
+                                double beam_energy, double volume_material) {
+  try {
+    if(n == 0 || !types || !z || !material || !(beam_energy > 0.) || !(volume_material > 0.)) {
+      LOG(logERROR) << "Invalid telescope definition";
+      return nullptr;
+    }
+
+    std::vector<plane> planes;
+    planes.reserve(n);
+    for(size_t p = 0; p < n; p++) {
+      if(!isValid(z[p]) || !(material[p] >= 0.)) {
+        LOG(logERROR) << "Invalid position or material of plane " << p;
+        return nullptr;
+      }
+      switch(types[p]) {
+      case GBLSIM_REFERENCE: planes.push_back(plane::reference(z[p])); break;
+      case GBLSIM_INACTIVE: planes.push_back(plane::inactive(z[p], material[p])); break;
+      case GBLSIM_ACTIVE:
+        if(!resolution_x || !resolution_y || !(resolution_x[p] > 0.) || !(resolution_y[p] > 0.)) {
+          LOG(logERROR) << "Missing resolution of active plane " << p;
+          return nullptr;
+        }
+        planes.push_back(plane::active(z[p], material[p], std::make_pair(resolution_x[p], resolution_y[p])));
+        break;
+      case GBLSIM_UNKNOWN:
+        if(!size || !(size[p] >= 0.)) {
+          LOG(logERROR) << "Missing size of unknown scatterer " << p;
+          return nullptr;
+        }
+        planes.push_back(plane::unknown(z[p], size[p]));
+        break;
+      default:
+        LOG(logERROR) << "Invalid type " << types[p] << " of plane " << p;
+        return nullptr;
+      }
+    }
+
+    gblsim_telescope* telescope = new gblsim_telescope;
+    telescope->planes.swap(planes);
+    telescope->beam_energy = beam_energy;
+    telescope->volume = volume_material;
+    telescope->slots.resize(threadpool::global().size() + 1);
+    return telescope;
+  }
+  catch(...) {
+    internalError(__func__);
+    return nullptr;
+  }
+}
+
+void gblsim_destroy(gblsim_telescope* telescope) {
+  try {
+    delete telescope;
+  }
+  catch(...) {
+    internalError(__func__);
+  }
+}
+
+size_t gblsim_planes(const gblsim_telescope* telescope) {
+  return telescope ? telescope->planes.size() : 0;
+}
+
+int gblsim_set_beam_energy(gblsim_telescope* telescope, double beam_energy) {
+  try {
+    if(!telescope) return GBLSIM_INVALID_HANDLE;
+    if(!(beam_energy > 0.) || !isValid(beam_energy)) return GBLSIM_INVALID_ARGUMENT;
+    telescope->beam_energy = beam_energy;
+    return GBLSIM_OK;
+  }
+  catch(...) {
+    return internalError(__func__);
+  }
+}
+
+int gblsim_set_position(gblsim_telescope* telescope, size_t plane, double z) {
+  try {
+    if(!telescope) return GBLSIM_INVALID_HANDLE;
+    if(plane >= telescope->planes.size()) return GBLSIM_INVALID_INDEX;
+    if(!isValid(z)) return GBLSIM_INVALID_ARGUMENT;
+    telescope->planes[plane].setPosition(z);
+    return GBLSIM_OK;
+  }
+  catch(...) {
+    return internalError(__func__);
+  }
+}
+
+int gblsim_set_material(gblsim_telescope* telescope, size_t plane, double material) {
+  try {
+    if(!telescope) return GBLSIM_INVALID_HANDLE;
+    if(plane >= telescope->planes.size()) return GBLSIM_INVALID_INDEX;
+    if(!(material >= 0.) || !isValid(material)) return GBLSIM_INVALID_ARGUMENT;
+    telescope->planes[plane].setMaterial(material);
+    return GBLSIM_OK;
+  }
+  catch(...) {
+    return internalError(__func__);
+  }
+}
+
+int gblsim_set_resolution(gblsim_telescope* telescope, size_t plane, double resolution_x, double resolution_y) {
+  try {
+    if(!telescope) return GBLSIM_INVALID_HANDLE;
+    if(plane >= telescope->planes.size()) return GBLSIM_INVALID_INDEX;
+    if(!telescope->planes[plane].measurement()) return GBLSIM_INVALID_ARGUMENT;
+    if(!(resolution_x > 0.) || !(resolution_y > 0.) || !isValid(resolution_x) || !isValid(resolution_y)) {
+      return GBLSIM_INVALID_ARGUMENT;
+    }
+    telescope->planes[plane] = withResolution(telescope->planes[plane], resolution_x, resolution_y);
+    return GBLSIM_OK;
+  }
+  catch(...) {
+    return internalError(__func__);
+  }
+}
+
+int gblsim_evaluate(gblsim_telescope* telescope, double* resolution, double* kink) {
+  try {
+    if(!telescope) return GBLSIM_INVALID_HANDLE;
+
+    scratch& s = telescope->slots.front();
+    prepare(s, telescope->planes);
+    sortPlanes(s);
+    gblsim::telescope tel(s.sorted, telescope->beam_energy, telescope->volume);
+
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    for(size_t p = 0; p < s.planes.size(); p++) {
+      if(resolution) {
+        std::pair<double,double> r = tel.getResolutionXY(s.rank[p]);
+        resolution[2*p] = r.first;
+        resolution[2*p+1] = r.second;
+      }
+      if(kink) {
+        std::pair<double,double> k = (s.planes[p].isUnknown() ? tel.getKinkResolutionXY(s.rank[p]) : std::make_pair(nan, nan));
+        kink[2*p] = k.first;
+        kink[2*p+1] = k.second;
+      }
+    }
+    return GBLSIM_OK;
+  }
+  catch(...) {
+    return internalError(__func__);
+  }
+}
+
+int gblsim_evaluate_batch(gblsim_telescope* telescope, int parameter, size_t parameter_plane,
+                          size_t variants, const double* values, int quantity, size_t target, double* output) {
+  try {
+    if(!telescope) return GBLSIM_INVALID_HANDLE;
+    const std::vector<plane>& planes = telescope->planes;
+    if(target >= planes.size() || (parameter != GBLSIM_BEAM_ENERGY && parameter_plane >= planes.size())) {
+      return GBLSIM_INVALID_INDEX;
+    }
+    if(variants == 0) return GBLSIM_OK;
+    if(!values || !output) return GBLSIM_INVALID_ARGUMENT;
+    if(quantity == GBLSIM_KINK_RESOLUTION && !planes[target].isUnknown()) return GBLSIM_NOT_UNKNOWN;
+    if(quantity != GBLSIM_TRACK_RESOLUTION && quantity != GBLSIM_KINK_RESOLUTION) return GBLSIM_INVALID_ARGUMENT;
+
+    // Check all values before evaluating any variant:
+    for(size_t v = 0; v < variants; v++) {
+      bool valid = isValid(values[v]);
+      switch(parameter) {
+      case GBLSIM_BEAM_ENERGY: valid &= (values[v] > 0.); break;
+      case GBLSIM_POSITION: break;
+      case GBLSIM_MATERIAL: valid &= (values[v] >= 0.); break;
+      case GBLSIM_RESOLUTION: valid &= (values[v] > 0. && planes[parameter_plane].measurement()); break;
+      default: valid = false;
+      }
+      if(!valid) return GBLSIM_INVALID_ARGUMENT;
+    }
+
+    // Every slot evaluates every n-th variant with its own working memory. Variants not evaluated
+    // after a failure stay NaN:
+    size_t n = std::min(telescope->slots.size(), variants);
+    std::fill(output, output + 2*variants, std::numeric_limits<double>::quiet_NaN());
+    threadpool::global().parallel_for(n, [&](size_t slot) {
+        scratch& s = telescope->slots[slot];
+        prepare(s, planes);
+        for(size_t v = slot; v < variants; v += n) {
+          double energy = telescope->beam_energy;
+          if(parameter == GBLSIM_BEAM_ENERGY) energy = values[v];
+          else if(parameter == GBLSIM_POSITION) s.planes[parameter_plane].setPosition(values[v]);
+          else if(parameter == GBLSIM_MATERIAL) s.planes[parameter_plane].setMaterial(values[v]);
+          else s.planes[parameter_plane] = withResolution(planes[parameter_plane], values[v], values[v]);
+
+          sortPlanes(s);
+          gblsim::telescope tel(s.sorted, energy, telescope->volume);
+          std::pair<double,double> result = (quantity == GBLSIM_TRACK_RESOLUTION ? tel.getResolutionXY(s.rank[target])
+                                             : tel.getKinkResolutionXY(s.rank[target]));
+          output[2*v] = result.first;
+          output[2*v+1] = result.second;
+        }
+      });
+    return GBLSIM_OK;
+  }
+  catch(...) {
+    return internalError(__func__);
+  }
+}
@@ -0,0 +1,108 @@
+/**
+ * C interface of the resolution calculator for embedding in other frameworks and for FFI
+ *
+ * Only plain C types cross this interface, so users neither include nor link against GBL,
+ * Eigen or ROOT headers, and the layout of all arguments is stable between releases. Breaking
+ * changes increase GBLSIM_ABI_VERSION, compare it with gblsim_abi_version() at runtime.
+ *
+ * A telescope handle holds a geometry and the beam energy. Parameters are updated in place and
+ * results are written to buffers provided by the caller; after the first evaluation of a handle
+ * the interface itself does not allocate, only the track fit does internally. All positions
+ * and resolutions are in [mm], results in [um] and [urad].
+ *
+ * Thread safety: a handle must not be used from more than one thread at a time, which includes
+ * updates and evaluations. Different handles are independent and may be used concurrently from
+ * any threads. Batch evaluations distribute the variants over the library's thread pool and
+ * return once all results are written.
+ */
+
+#ifndef CAPI_H
+#define CAPI_H
+
+#include <stddef.h>
+
+#define GBLSIM_ABI_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  /* Return codes, all functions returning int report success with GBLSIM_OK */
+  enum gblsim_status {
+    GBLSIM_OK = 0,
+    GBLSIM_INVALID_HANDLE = -1,
+    GBLSIM_INVALID_ARGUMENT = -2,
+    GBLSIM_INVALID_INDEX = -3,
+    GBLSIM_NOT_UNKNOWN = -4,
+    GBLSIM_INTERNAL_ERROR = -5
+  };
+
+  /* Plane types, see gblsim::plane */
+  enum gblsim_plane_type {
+    GBLSIM_REFERENCE = 0,
+    GBLSIM_INACTIVE = 1,
+    GBLSIM_ACTIVE = 2,
+    GBLSIM_UNKNOWN = 3
+  };
+
+  /* Parameters varied in batch evaluations */
+  enum gblsim_parameter {
+    GBLSIM_BEAM_ENERGY = 0,
+    GBLSIM_POSITION = 1,
+    GBLSIM_MATERIAL = 2,
+    GBLSIM_RESOLUTION = 3
+  };
+
+  /* Quantities evaluated in batches */
+  enum gblsim_quantity {
+    GBLSIM_TRACK_RESOLUTION = 0,
+    GBLSIM_KINK_RESOLUTION = 1
+  };
+
+  typedef struct gblsim_telescope gblsim_telescope;
+
+  int gblsim_abi_version(void);
+  const char* gblsim_status_string(int status);
+  /* Verbosity of the library log on standard error, e.g. "ERROR" or "INFO" */
+  void gblsim_set_log_level(const char* level);
+
+  /*
+   * Create a telescope of n planes from arrays of length n: plane types, positions z and
+   * material budgets x/X0. Resolutions in x and y are only read for active planes and sizes only
+   * for unknown scatterers, both arrays may be NULL if no plane needs them. The volume material
+   * is the radiation length of the surrounding volume in [mm]. Returns NULL on invalid input or
+   * internal errors.
+   */
+  gblsim_telescope* gblsim_create(size_t n, const int* types, const double* z, const double* material,
+                                  const double* resolution_x, const double* resolution_y, const double* size,
+                                  double beam_energy, double volume_material);
+  void gblsim_destroy(gblsim_telescope* telescope);
+  size_t gblsim_planes(const gblsim_telescope* telescope);
+
+  /* Update parameters in place, planes keep the index given at creation */
+  int gblsim_set_beam_energy(gblsim_telescope* telescope, double beam_energy);
+  int gblsim_set_position(gblsim_telescope* telescope, size_t plane, double z);
+  int gblsim_set_material(gblsim_telescope* telescope, size_t plane, double material);
+  int gblsim_set_resolution(gblsim_telescope* telescope, size_t plane, double resolution_x, double resolution_y);
+
+  /*
+   * Evaluate the current geometry. Track resolutions of all planes are written as x,y pairs to
+   * resolution (2n values), kink resolutions to kink (2n values, NaN for planes which are not
+   * unknown scatterers). Either buffer may be NULL.
+   */
+  int gblsim_evaluate(gblsim_telescope* telescope, double* resolution, double* kink);
+
+  /*
+   * Evaluate variants of the current geometry, each with one parameter set to values[v]: the
+   * beam energy, or position, material or resolution (both dimensions) of plane parameter_plane.
+   * The quantity at plane target is written as x,y pair to output (2*variants values), NaN for
+   * variants not evaluated after an internal error. The geometry of the handle is not changed.
+   */
+  int gblsim_evaluate_batch(gblsim_telescope* telescope, int parameter, size_t parameter_plane,
+                            size_t variants, const double* values, int quantity, size_t target, double* output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAPI_H */
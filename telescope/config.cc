@@ -0,0 +1,282 @@
+// Telescope setups from configuration files
+
+#include "config.h"
+#include "constants.h"
+#include "log.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+using namespace gblsim;
+using namespace unilog;
+
+namespace {
+  // Recursive descent parser for sums, products, signs and parentheses
+  class parser {
+  public:
+    parser(const std::string& text, const std::map<std::string, double>& variables) :
+      m_text(text), m_pos(0), m_variables(variables), m_valid(true) {}
+
+    bool parse(double& value) {
+      value = sum();
+      skip();
+      return m_valid && m_pos == m_text.size();
+    }
+
+  private:
+    void skip() { while(m_pos < m_text.size() && std::isspace(m_text[m_pos])) m_pos++; }
+    bool accept(char c) {
+      skip();
+      if(m_pos < m_text.size() && m_text[m_pos] == c) {
+        m_pos++;
+        return true;
+      }
+      return false;
+    }
+
+    double sum() {
+      double value = product();
+      while(true) {
+        if(accept('+')) value += product();
+        else if(accept('-')) value -= product();
+        else return value;
+      }
+    }
+
+    double product() {
+      double value = factor();
+      while(true) {
+        if(accept('*')) value *= factor();
+        else if(accept('/')) value /= factor();
+        else return value;
+      }
+    }
+
+    double factor() {
+      if(accept('-')) return -factor();
+      if(accept('+')) return factor();
+      if(accept('(')) {
+        double value = sum();
+        if(!accept(')')) m_valid = false;
+        return value;
+      }
+      skip();
+      if(m_pos < m_text.size() && (std::isalpha(m_text[m_pos]) || m_text[m_pos] == '_')) {
+        size_t start = m_pos;
+        while(m_pos < m_text.size() && (std::isalnum(m_text[m_pos]) || m_text[m_pos] == '_')) m_pos++;
+        auto it = m_variables.find(m_text.substr(start, m_pos - start));
+        if(it == m_variables.end()) {
+          m_valid = false;
+          return 0.;
+        }
+        return it->second;
+      }
+      const char* begin = m_text.c_str() + m_pos;
+      char* end = nullptr;
+      double value = std::strtod(begin, &end);
+      if(end == begin) m_valid = false;
+      m_pos += end - begin;
+      return value;
+    }
+
+    std::string m_text;
+    size_t m_pos;
+    const std::map<std::string, double>& m_variables;
+    bool m_valid;
+  };
+}
+
+configreader::configreader() : m_variables() {
+  // Radiation lengths from materials.h:
+  m_variables["X0_Si"] = X0_Si;
+  m_variables["X0_Diamond"] = X0_Diamond;
+  m_variables["X0_Al"] = X0_Al;
+  m_variables["X0_Au"] = X0_Au;
+  m_variables["X0_Cu"] = X0_Cu;
+  m_variables["X0_Air"] = X0_Air;
+  m_variables["X0_He"] = X0_He;
+  m_variables["X0_Kapton"] = X0_Kapton;
+  m_variables["X0_PCB"] = X0_PCB;
+  // Resolutions from constants.h:
+  m_variables["resolution_analog"] = resolution_analog;
+  m_variables["resolution_analog_y"] = resolution_analog_y;
+  m_variables["resolution_digital"] = resolution_digital;
+  m_variables["resolution_digital_y"] = resolution_digital_y;
+}
+
+bool configreader::evaluate(const std::string& expression, double& value) const {
+  parser p(expression, m_variables);
+  return p.parse(value);
+}
+
+bool configreader::read(const std::string& filename, std::vector<setup>& setups) {
+
+  std::ifstream in(filename.c_str());
+  if(!in) {
+    LOG(logERROR) << "Cannot open configuration file " << filename;
+    return false;
+  }
+
+  bool valid = true, current_valid = true;
+  setup current;
+  auto finish = [&]() {
+    if(current.name.empty()) return;
+    if(current_valid && !current.planes.empty()) setups.push_back(current);
+    else LOG(logERROR) << "Skipping setup " << current.name << " from " << filename;
+  };
+
+  std::string line;
+  size_t number = 0;
+  while(std::getline(in, line)) {
+    number++;
+    line = line.substr(0, line.find('#'));
+    std::istringstream tokens(line);
+    std::string keyword;
+    if(!(tokens >> keyword)) continue;
+
+    auto error = [&](const std::string& message) {
+      LOG(logERROR) << filename << ":" << number << ": " << message;
+      valid = false;
+      current_valid = false;
+    };
+
+    // New setup:
+    if(keyword.front() == '[') {
+      finish();
+      current = setup();
+      current.name = keyword.substr(1, keyword.find(']') - 1);
+      current.beam_energy = 0.;
+      current.material = X0_Air;
+      current_valid = true;
+      continue;
+    }
+
+    // Variable definition, the name is followed by '=' with or without spaces and the expression
+    // is the remainder of the line:
+    if(keyword == "set") {
+      std::string definition, name, extra;
+      std::getline(tokens, definition);
+      size_t equal = definition.find('=');
+      std::istringstream left(definition.substr(0, equal));
+      left >> name;
+      double value;
+      if(equal == std::string::npos || name.empty() || (left >> extra) || !evaluate(definition.substr(equal + 1), value)) {
+        error("invalid variable definition");
+        continue;
+      }
+      m_variables[name] = value;
+      continue;
+    }
+
+    if(current.name.empty()) {
+      error("statement outside of a setup");
+      continue;
+    }
+
+    // Outputs take a type and an optional plane index:
+    if(keyword == "output") {
+      output out;
+      out.plane = -1;
+      tokens >> out.type;
+      if(out.type != "residuals" && !(tokens >> out.plane)) {
+        error("output " + out.type + " needs a plane index");
+        continue;
+      }
+      if(out.type != "resolution" && out.type != "resolutionxy" && out.type != "kink" && out.type != "kinkxy" && out.type != "residuals") {
+        error("unknown output " + out.type);
+        continue;
+      }
+      current.outputs.push_back(out);
+      continue;
+    }
+
+    // All other statements take expressions separated by whitespace:
+    std::vector<double> values;
+    std::string token;
+    bool parsed = true;
+    while(tokens >> token) {
+      double value;
+      if(!evaluate(token, value)) {
+        error("cannot evaluate " + token);
+        parsed = false;
+        break;
+      }
+      values.push_back(value);
+    }
+    if(!parsed) continue;
+
+    if(keyword == "beam" && values.size() == 1) current.beam_energy = values.at(0);
+    else if(keyword == "volume" && values.size() == 1) current.material = values.at(0);
+    else if(keyword == "active" && values.size() == 3) current.planes.push_back(plane::active(values.at(0), values.at(1), values.at(2)));
+    else if(keyword == "active" && values.size() == 4) {
+      current.planes.push_back(plane::active(values.at(0), values.at(1), std::make_pair(values.at(2), values.at(3))));
+    }
+    else if(keyword == "inactive" && values.size() == 2) current.planes.push_back(plane::inactive(values.at(0), values.at(1)));
+    else if(keyword == "unknown" && values.size() == 2) current.planes.push_back(plane::unknown(values.at(0), values.at(1)));
+    else if(keyword == "reference" && values.size() == 1) current.planes.push_back(plane::reference(values.at(0)));
+    else error("invalid statement " + keyword);
+  }
+  finish();
+
+  for(auto& s : setups) {
+    if(s.beam_energy <= 0.) {
+      LOG(logERROR) << "Setup " << s.name << " has no beam energy.";
+      valid = false;
+    }
+  }
+  LOG(logINFO) << "Read " << setups.size() << " setups from " << filename;
+  return valid;
+}
+
+std::vector<std::string> gblsim::run(const setup& config, resultcache* cache) {
+
+  std::vector<std::string> lines;
+
+  // Results either from the cache, which holds all planes, or from a fit of the requested ones:
+  std::vector<planeresult> cached;
+  std::unique_ptr<telescope> tel;
+  if(cache) cached = cache->evaluate(config.planes, config.beam_energy, config.material);
+  else tel.reset(new telescope(config.planes, config.beam_energy, config.material));
+
+  for(const auto& out : config.outputs) {
+    if(out.type != "residuals" && (out.plane < 0 || out.plane >= static_cast<int>(config.planes.size()))) {
+      LOG(logERROR) << "Setup " << config.name << ": plane " << out.plane << " does not exist.";
+      continue;
+    }
+    std::ostringstream line;
+    line << config.name << "\t" << out.type << "\t";
+    if(out.type == "resolution" || out.type == "resolutionxy") {
+      std::pair<double,double> res = (cache ? cached.at(out.plane).resolution : tel->getResolutionXY(out.plane));
+      line << out.plane << "\t" << res.first;
+      if(out.type == "resolutionxy") line << "\t" << res.second;
+    }
+    else if(out.type == "kink" || out.type == "kinkxy") {
+      std::pair<double,double> res = (cache ? cached.at(out.plane).kink : tel->getKinkResolutionXY(out.plane));
+      line << out.plane << "\t" << res.first;
+      if(out.type == "kinkxy") line << "\t" << res.second;
+    }
+    else {
+      // One line per measurement plane with biased and unbiased widths:
+      std::vector<residual> residuals;
+      if(cache) {
+        for(size_t p = 0; p < cached.size(); p++) {
+          if(!std::isnan(cached[p].biased.first)) residuals.push_back(residual{static_cast<int>(p), cached[p].biased, cached[p].unbiased});
+        }
+      }
+      else residuals = tel->getResidualWidths();
+      for(const auto& r : residuals) {
+        std::ostringstream residual;
+        residual << config.name << "\tresiduals\t" << r.plane << "\t" << r.biased.first << "\t" << r.biased.second
+                 << "\t" << r.unbiased.first << "\t" << r.unbiased.second;
+        lines.push_back(residual.str());
+      }
+      continue;
+    }
+    lines.push_back(line.str());
+  }
+  return lines;
+}
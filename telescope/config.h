@@ -0,0 +1,69 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "assembly.h"
+#include "cache.h"
+
+namespace gblsim {
+
+  // Result requested for a setup, for a plane given by its index in the z-ordered planes
+  struct output {
+    // One of resolution, resolutionxy, kink, kinkxy or residuals (all measurement planes)
+    std::string type;
+    int plane;
+  };
+
+  // Telescope setup read from a configuration file
+  struct setup {
+    std::string name;
+    std::vector<plane> planes;
+    double beam_energy;
+    double material;
+    std::vector<output> outputs;
+  };
+
+  // Reader for telescope setups from text files.
+  //
+  // Every setup starts with its name in square brackets, followed by one statement per line:
+  //
+  //   [datura]
+  //   set MIM26 = 55e-3/X0_Si + 50e-3/X0_Kapton
+  //   beam 5.0
+  //   volume X0_Air
+  //   active 0 MIM26 3.24e-3
+  //   inactive 60 0.01
+  //   unknown 60 2*0.25
+  //   reference 100
+  //   output resolution 3
+  //
+  // Active planes take position, material budget x/X0 and one or two resolutions, inactive planes
+  // position and material budget, unknown scatterers position and size, reference planes only the
+  // position. All numbers can be arithmetic expressions without spaces of the radiation lengths from materials.h,
+  // the resolutions from constants.h and variables defined with set, which remain valid for all
+  // following setups. Text after # is ignored.
+  class configreader {
+  public:
+    configreader();
+
+    // Read all setups from the file, returns false if the file cannot be read or contains errors.
+    // Setups with errors are skipped.
+    bool read(const std::string& filename, std::vector<setup>& setups);
+
+    // Evaluate an arithmetic expression, returns false for invalid expressions
+    bool evaluate(const std::string& expression, double& value) const;
+
+  private:
+    std::map<std::string, double> m_variables;
+  };
+
+  // Run a setup and return one line per requested result. With a cache, the results of all planes
+  // are taken from it or fitted and stored.
+  std::vector<std::string> run(const setup& config, resultcache* cache = nullptr);
+
+}
+
+#endif /* CONFIG_H */
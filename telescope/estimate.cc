@@ -0,0 +1,173 @@
+// Closed-form resolution bounds for scan pruning
+
+#include "estimate.h"
+#include "log.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace gblsim;
+using namespace unilog;
+
+namespace {
+  // Number of kinks included in the fit for the lower bound:
+  const size_t bound_kinks = 4;
+
+  struct kink {
+    kink(double position, double variance) : position(position), variance(variance), contribution(0.) {}
+    double position;
+    double variance;
+    double contribution;
+  };
+}
+
+bounds gblsim::estimateResolution(const std::vector<layer<double>>& layers, size_t index,
+                                  double beam_energy, double material, double total_material) {
+
+  const double infinity = std::numeric_limits<double>::infinity();
+  bounds result = {infinity, infinity};
+  if(index >= layers.size()) {
+    LOG(logERROR) << "Layer " << index << " does not exist.";
+    return result;
+  }
+
+  // Weighted sums of the straight-line fit:
+  double s0 = 0, s1 = 0, s2 = 0;
+  double zmin = infinity, zmax = -infinity, total = 0;
+  bool unknown = false;
+  for(const auto& l : layers) {
+    zmin = std::min(zmin, l.position);
+    zmax = std::max(zmax, l.position);
+    total += l.material;
+    unknown |= l.isUnknown();
+    if(!l.measurement) continue;
+    double w = 1./(l.resolution*l.resolution);
+    s0 += w;
+    s1 += w*l.position;
+    s2 += w*l.position*l.position;
+  }
+  double sxx = s2 - s1*s1/s0;
+  // Offset and slope need two measurements at different positions:
+  if(!(s0 > 0.) || !(sxx > 1e-12*s2)) return result;
+
+  double z = layers.at(index).position;
+  double zbar = s1/s0;
+  double straight = 1./s0 + (z - zbar)*(z - zbar)/sxx;
+  result.lower = std::sqrt(straight)*1E3;
+  if(unknown) return result;
+
+  // Weights of the measurements in the straight-line estimate at the layer:
+  std::vector<std::pair<double,double>> weights;
+  for(const auto& l : layers) {
+    if(l.measurement) weights.push_back(std::make_pair(l.position, (1./s0 + (l.position - zbar)*(z - zbar)/sxx)/(l.resolution*l.resolution)));
+  }
+
+  // Position error of the estimate caused by a unit kink at zk:
+  auto response = [&weights, z](double zk) {
+    double c = -std::max(z - zk, 0.);
+    for(const auto& w : weights) c += w.second*std::max(w.first - zk, 0.);
+    return c;
+  };
+
+  // Scattering at all planes and the two volume scatterers per gap, as in the telescope class:
+  std::vector<kink> kinks;
+  if(material > 0.0) total += (zmax - zmin)/material;
+  if(total_material > 0.0) total = total_material;
+  double highland = 0.0136/beam_energy*(1. + 0.038*std::log(total));
+  std::vector<double> positions;
+  for(const auto& l : layers) {
+    positions.push_back(l.position);
+    if(l.material > 0.0) kinks.push_back(kink(l.position, highland*highland*l.material));
+  }
+  if(material > 0.0) {
+    std::sort(positions.begin(), positions.end());
+    for(size_t p = 1; p < positions.size(); p++) {
+      double distance = positions.at(p) - positions.at(p-1);
+      for(double fraction : {0.21, 0.79}) {
+        kinks.push_back(kink(positions.at(p-1) + fraction*distance, highland*highland*0.5*distance/material));
+      }
+    }
+  }
+
+  double variance = 0;
+  for(auto& k : kinks) {
+    k.contribution = k.variance*std::pow(response(k.position), 2);
+    variance += k.contribution;
+  }
+  result.upper = std::sqrt(straight + variance)*1E3;
+
+  // Fit with the kinks contributing most to the upper bound, the others still neglected:
+  size_t nkinks = std::min(kinks.size(), bound_kinks);
+  std::partial_sort(kinks.begin(), kinks.begin() + nkinks, kinks.end(), [](const kink& a, const kink& b) {
+      return a.contribution > b.contribution;
+    });
+  Eigen::MatrixXd information = Eigen::MatrixXd::Zero(2 + nkinks, 2 + nkinks);
+  auto derivatives = [&kinks, nkinks, zmin](double zp) {
+    Eigen::VectorXd h(2 + nkinks);
+    h(0) = 1.;
+    h(1) = zp - zmin;
+    for(size_t k = 0; k < nkinks; k++) h(2 + k) = std::max(zp - kinks.at(k).position, 0.);
+    return h;
+  };
+  for(const auto& l : layers) {
+    if(!l.measurement) continue;
+    Eigen::VectorXd h = derivatives(l.position);
+    information += h*h.transpose()/(l.resolution*l.resolution);
+  }
+  for(size_t k = 0; k < nkinks; k++) information(2 + k, 2 + k) += 1./kinks.at(k).variance;
+  Eigen::VectorXd h = derivatives(z);
+  result.lower = std::max(result.lower, std::sqrt(h.dot(information.ldlt().solve(h)))*1E3);
+  return result;
+}
+
+bounds gblsim::estimateResolution(std::vector<plane> planes, int index, double beam_energy, double material) {
+  std::stable_sort(planes.begin(), planes.end());
+  std::vector<layer<double>> layers;
+  for(const auto& pl : planes) layers.push_back(layer<double>(pl));
+  return estimateResolution(layers, index, beam_energy, material);
+}
+
+std::vector<std::pair<size_t, double>> gblsim::screen(const std::vector<std::vector<plane>>& candidates, int index,
+                                                      double beam_energy, unsigned int k, size_t& fits,
+                                                      double material) {
+
+  // Order the candidates by their lower bound:
+  std::vector<std::pair<double, size_t>> order;
+  for(size_t c = 0; c < candidates.size(); c++) {
+    order.push_back(std::make_pair(estimateResolution(candidates.at(c), index, beam_energy, material).lower, c));
+  }
+  std::sort(order.begin(), order.end());
+
+  std::vector<std::pair<size_t, double>> best;
+  auto threshold = [&best, k]() {
+    return (best.size() < k ? std::numeric_limits<double>::infinity() : best.back().second);
+  };
+
+  fits = 0;
+  const size_t batch = threadpool::global().size();
+  size_t next = 0;
+  while(next < order.size() && k > 0 && order.at(next).first < threshold()) {
+    // Fit a batch of candidates in parallel:
+    size_t end = std::min(next + batch, order.size());
+    std::vector<double> resolution(end - next);
+    threadpool::global().parallel_for(end - next, [&](size_t i) {
+        resolution.at(i) = telescope(candidates.at(order.at(next + i).second), beam_energy, material).getResolution(index);
+      });
+    fits += end - next;
+
+    for(size_t i = 0; i < resolution.size(); i++) {
+      best.push_back(std::make_pair(order.at(next + i).second, resolution.at(i)));
+    }
+    std::sort(best.begin(), best.end(), [](const std::pair<size_t, double>& a, const std::pair<size_t, double>& b) {
+        return a.second < b.second;
+      });
+    if(best.size() > k) best.resize(k);
+    next = end;
+  }
+
+  LOG(logINFO) << "Screened " << candidates.size() << " candidates with " << fits << " full fits, "
+               << candidates.size() - fits << " fits saved";
+  return best;
+}
@@ -0,0 +1,44 @@
+#ifndef ESTIMATE_H
+#define ESTIMATE_H
+
+#include <utility>
+#include <vector>
+
+#include "assembly.h"
+#include "trackmodel.h"
+
+namespace gblsim {
+
+  // Closed-form bounds on the track resolution along the first dimension [um]
+  struct bounds {
+    double lower;
+    double upper;
+  };
+
+  // Tier-0 estimate of the resolution at a layer (index in the input vector) without a track fit.
+  //
+  // The upper bound is the true resolution of the straight-line fit to all measurements, including
+  // the scattering at all planes and the volume scatterers. Since the full fit is the best linear
+  // estimate under scattering, it cannot do worse. The lower bound is the resolution of a small fit
+  // with only the few kinks contributing most to the upper bound, neglecting all other scattering,
+  // which can only improve the resolution. Unknown scatterers allow arbitrary kinks, the upper
+  // bound is then infinite and the lower bound neglects all scattering. The total material budget
+  // of the Highland formula is taken from the layers unless given.
+  bounds estimateResolution(const std::vector<layer<double>>& layers, size_t index,
+                            double beam_energy, double material = X0_Air, double total_material = 0.);
+
+  // Same for a plane given by its index in the z-ordered planes as in telescope::getResolution()
+  bounds estimateResolution(std::vector<plane> planes, int index,
+                            double beam_energy, double material = X0_Air);
+
+  // Rank candidate telescopes by the resolution at the given plane, returning the indices and
+  // resolutions of the k best. Candidates are fitted in order of their lower bound, in batches
+  // on the global thread pool, and the scan stops as soon as no remaining candidate can beat
+  // the current k-th best. The number of full fits performed is returned in fits.
+  std::vector<std::pair<size_t, double>> screen(const std::vector<std::vector<plane>>& candidates, int index,
+                                                double beam_energy, unsigned int k, size_t& fits,
+                                                double material = X0_Air);
+
+}
+
+#endif /* ESTIMATE_H */
@@ -0,0 +1,133 @@
+// Lazy scans over parameter grids
+
+#include "gridscan.h"
+#include "threadpool.h"
+#include "log.h"
+
+#include <algorithm>
+#include <exception>
+
+using namespace gblsim;
+using namespace unilog;
+
+gridscan::gridscan(std::vector<std::vector<double>> axes, function evaluate, bool ordered, size_t capacity) :
+  m_axes(axes),
+  m_evaluate(evaluate),
+  m_ordered(ordered),
+  m_capacity(std::max<size_t>(capacity, 1)),
+  m_size(axes.empty() ? 0 : 1),
+  m_mutex(),
+  m_changed(),
+  m_started(0),
+  m_returned(0),
+  m_outstanding(0),
+  m_running(0),
+  m_cancelled(false),
+  m_error(),
+  m_finished(),
+  m_completed()
+{
+  for(const auto& axis : m_axes) m_size *= axis.size();
+  LOG(logDEBUG) << "Scanning " << m_size << " points in " << m_axes.size() << " dimensions";
+}
+
+gridscan::~gridscan() {
+  cancel();
+}
+
+std::vector<double> gridscan::getPoint(size_t index) const {
+  std::vector<double> point(m_axes.size());
+  for(size_t a = m_axes.size(); a-- > 0;) {
+    point[a] = m_axes[a][index % m_axes[a].size()];
+    index /= m_axes[a].size();
+  }
+  return point;
+}
+
+void gridscan::schedule() {
+  while(!m_cancelled && m_outstanding < m_capacity && m_started < m_size) {
+    size_t index = m_started++;
+    m_outstanding++;
+    m_running++;
+    threadpool::global().submit([this, index]() { compute(index); });
+  }
+}
+
+void gridscan::compute(size_t index) {
+  result r;
+  r.index = index;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_cancelled) {
+      m_running--;
+      m_changed.notify_all();
+      return;
+    }
+  }
+  r.point = getPoint(index);
+  std::exception_ptr error;
+  try {
+    r.values = m_evaluate(r.point);
+  }
+  catch(...) {
+    // The pool would swallow the exception, it is passed on to the consumer instead:
+    error = std::current_exception();
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if(error) {
+    LOG(logERROR) << "Evaluation of point " << index << " failed, cancelling scan";
+    if(!m_error) m_error = error;
+    m_cancelled = true;
+    m_running--;
+    m_changed.notify_all();
+    return;
+  }
+  if(m_ordered) m_finished[index] = std::move(r);
+  else m_completed.push_back(std::move(r));
+  m_running--;
+  m_changed.notify_all();
+}
+
+bool gridscan::next(result& r) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  // Points are started lazily with the first request:
+  schedule();
+  m_changed.wait(lock, [this]() {
+      return m_cancelled || m_returned == m_size
+        || (m_ordered ? m_finished.count(m_returned) > 0 : !m_completed.empty());
+    });
+  if(m_error) {
+    std::exception_ptr error = m_error;
+    m_error = nullptr;
+    std::rethrow_exception(error);
+  }
+  if(m_cancelled || m_returned == m_size) return false;
+
+  if(m_ordered) {
+    auto it = m_finished.find(m_returned);
+    r = std::move(it->second);
+    m_finished.erase(it);
+  }
+  else {
+    r = std::move(m_completed.front());
+    m_completed.pop_front();
+  }
+  m_returned++;
+  m_outstanding--;
+  schedule();
+  return true;
+}
+
+void gridscan::cancel() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if(!m_cancelled && m_returned < m_size) {
+    LOG(logDEBUG) << "Cancelling scan after " << m_returned << " of " << m_size << " points";
+  }
+  m_cancelled = true;
+  // Running points refer to this scan:
+  m_changed.wait(lock, [this]() { return m_running == 0; });
+  m_finished.clear();
+  m_completed.clear();
+  m_changed.notify_all();
+}
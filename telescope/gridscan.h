@@ -0,0 +1,109 @@
+#ifndef GRIDSCAN_H
+#define GRIDSCAN_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace gblsim {
+
+  // Lazy scan over a grid of parameters, yielding results while they are computed.
+  //
+  // The grid is the product of the axes, with the last axis varying fastest. Points are evaluated
+  // on the global thread pool, at most capacity of them are computed or waiting to be consumed at
+  // any time, and a new point is only started when a result is taken (back-pressure), so memory
+  // is bounded independent of the grid size. Results are returned in grid order, or in completion
+  // order which avoids waiting for slow points. The scan can be consumed with next() or as a
+  // range in a for loop. cancel() or destroying the scan, e.g. after leaving the loop early,
+  // skips all points not yet started. Results have to be consumed outside of the thread pool:
+  //
+  //   gridscan scan({distances, materials}, evaluate);
+  //   for(const auto& r : scan) {
+  //     if(r.values[0] < target) break;
+  //   }
+  class gridscan {
+  public:
+    // Values computed for one point, called concurrently from the pool threads
+    typedef std::function<std::vector<double>(const std::vector<double>& point)> function;
+
+    struct result {
+      // Position in the grid and parameter values
+      size_t index;
+      std::vector<double> point;
+      std::vector<double> values;
+    };
+
+    gridscan(std::vector<std::vector<double>> axes, function evaluate, bool ordered = true, size_t capacity = 256);
+    ~gridscan();
+
+    size_t size() const { return m_size; }
+    std::vector<double> getPoint(size_t index) const;
+
+    // Wait for the next result, returns false when all results have been taken or after cancel().
+    // An exception thrown by the evaluation cancels the scan and is rethrown here once.
+    bool next(result& r);
+    // Start no more points and wait for the running ones
+    void cancel();
+
+    class iterator {
+    public:
+      typedef std::input_iterator_tag iterator_category;
+      typedef result value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef const result* pointer;
+      typedef const result& reference;
+
+      iterator() : m_scan(nullptr), m_result() {}
+      explicit iterator(gridscan* scan) : m_scan(scan), m_result() { ++(*this); }
+      const result& operator*() const { return m_result; }
+      const result* operator->() const { return &m_result; }
+      iterator& operator++() {
+        if(m_scan && !m_scan->next(m_result)) m_scan = nullptr;
+        return *this;
+      }
+      bool operator==(const iterator& other) const { return m_scan == other.m_scan; }
+      bool operator!=(const iterator& other) const { return m_scan != other.m_scan; }
+    private:
+      gridscan* m_scan;
+      result m_result;
+    };
+    // Single pass: iterating again continues where the last iteration stopped
+    iterator begin() { return iterator(this); }
+    iterator end() { return iterator(); }
+
+  private:
+    // Submit points until the capacity is reached, with the lock held
+    void schedule();
+    void compute(size_t index);
+
+    std::vector<std::vector<double>> m_axes;
+    function m_evaluate;
+    bool m_ordered;
+    size_t m_capacity;
+    size_t m_size;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    // Next point to start and to return in grid order:
+    size_t m_started;
+    size_t m_returned;
+    // Points started but not yet taken, and points still being computed:
+    size_t m_outstanding;
+    size_t m_running;
+    bool m_cancelled;
+    // First exception thrown by the evaluation, not yet rethrown:
+    std::exception_ptr m_error;
+    // Finished results waiting to be taken:
+    std::map<size_t, result> m_finished;
+    std::deque<result> m_completed;
+  };
+
+}
+
+#endif /* GRIDSCAN_H */
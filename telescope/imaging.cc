@@ -0,0 +1,100 @@
+// Material imaging from kink widths at an unknown scatterer
+
+#include "imaging.h"
+#include "propagate.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace gblsim;
+using namespace unilog;
+
+kinkimager::kinkimager(const telescope& tel, int plane, double max_materialbudget, unsigned int bins, int axis) :
+  m_beamEnergy(tel.getBeamEnergy()),
+  m_totalMaterialBudget(tel.getTotalMaterialBudget()),
+  m_kinkResolution(0),
+  m_widthMin(0),
+  m_widthMax(0),
+  m_invBinWidth(0),
+  m_table(std::max(bins, 1u) + 1)
+{
+  if(bins == 0) {
+    LOG(logERROR) << "Kink width lookup table needs at least one bin, using one.";
+    bins = 1;
+  }
+
+  // The kink resolution does not depend on the material of the unknown scatterer, fit only once:
+  std::pair<double,double> kink = tel.getKinkResolutionXY(plane);
+  m_kinkResolution = (axis == 0 ? std::get<0>(kink) : std::get<1>(kink));
+  LOG(logINFO) << "Kink resolution at plane " << plane << ": " << m_kinkResolution << "urad";
+
+  m_widthMin = getKinkWidth(0.);
+  m_widthMax = getKinkWidth(max_materialbudget);
+  double binwidth = (m_widthMax - m_widthMin)/bins;
+  m_invBinWidth = 1./binwidth;
+
+  // Invert the monotone kink width prediction at each table node by bisection:
+  for(unsigned int bin = 0; bin <= bins; bin++) {
+    double width = m_widthMin + bin*binwidth;
+    double low = 0., high = max_materialbudget;
+    for(int it = 0; it < 64; it++) {
+      double mid = 0.5*(low + high);
+      if(getKinkWidth(mid) < width) low = mid;
+      else high = mid;
+    }
+    m_table.at(bin) = 0.5*(low + high);
+  }
+  m_table.front() = 0.;
+  m_table.back() = max_materialbudget;
+
+  LOG(logDEBUG) << "Built kink width lookup table with " << bins << " bins between "
+                << m_widthMin << "urad and " << m_widthMax << "urad";
+}
+
+double kinkimager::getKinkWidth(double materialbudget) const {
+  // The unknown material adds to the total material of the track in the Highland formula:
+  double theta = (materialbudget > 0. ? getTheta(m_beamEnergy, materialbudget, m_totalMaterialBudget + materialbudget)*1E6 : 0.);
+  return sqrt(m_kinkResolution*m_kinkResolution + theta*theta);
+}
+
+std::pair<double,double> kinkimager::getMaterialBudget(double width, double width_error) const {
+  map2d w(1, 1, width), we(1, 1, width_error), x, xe;
+  invert(w, we, x, xe);
+  return std::make_pair(x.values.front(), xe.values.front());
+}
+
+void kinkimager::invert(const map2d& widths, const map2d& width_errors,
+                        map2d& materialbudget, map2d& materialbudget_errors) const {
+
+  materialbudget = widths;
+  materialbudget_errors = widths;
+  if(width_errors.nx != widths.nx || width_errors.ny != widths.ny || width_errors.values.size() != widths.values.size()) {
+    LOG(logERROR) << "Maps of kink widths and their errors differ in size.";
+    std::fill(materialbudget.values.begin(), materialbudget.values.end(), std::numeric_limits<double>::quiet_NaN());
+    std::fill(materialbudget_errors.values.begin(), materialbudget_errors.values.end(), std::numeric_limits<double>::quiet_NaN());
+    return;
+  }
+
+  const size_t cells = widths.values.size();
+  const size_t last = m_table.size() - 2;
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  const double* w = widths.values.data();
+  const double* we = width_errors.values.data();
+  const double* table = m_table.data();
+  double* x = materialbudget.values.data();
+  double* xe = materialbudget_errors.values.data();
+
+  // Branch-free table lookup so the loop over all cells can be vectorized:
+  for(size_t i = 0; i < cells; i++) {
+    // Missing widths are NaN and must not reach the conversion to an index:
+    bool valid = !std::isnan(w[i]) && w[i] <= m_widthMax;
+    double t = (valid ? std::max((w[i] - m_widthMin)*m_invBinWidth, 0.) : 0.);
+    size_t bin = std::min(static_cast<size_t>(t), last);
+    double slope = table[bin + 1] - table[bin];
+    double value = table[bin] + (t - bin)*slope;
+    x[i] = (valid ? value : nan);
+    xe[i] = (valid ? we[i]*slope*m_invBinWidth : nan);
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef IMAGING_H
+#define IMAGING_H
+
+#include <utility>
+#include <vector>
+
+#include "assembly.h"
+#include "map2d.h"
+
+namespace gblsim {
+
+  // Material imaging from measured kink widths at an unknown scatterer.
+  //
+  // The kink resolution of the telescope at the unknown plane is computed once. The predicted
+  // kink width sqrt(res^2 + theta(x/X0)^2) is monotone in the material budget x/X0 of the
+  // unknown scatterer, and is inverted via a lookup table equidistant in the kink width such
+  // that every cell of a measured map is converted without any search.
+  class kinkimager {
+  public:
+    // Prepare the lookup table for the unknown scatterer at the given plane, for material
+    // budgets between zero and max_materialbudget. The axis selects x (0) or y (1) kinks.
+    kinkimager(const telescope& tel, int plane, double max_materialbudget = 0.1,
+               unsigned int bins = 4096, int axis = 0);
+
+    // Return the kink resolution of the telescope at the unknown plane in [urad]
+    double getKinkResolution() const { return m_kinkResolution; }
+    // Return the predicted kink width for a given material budget x/X0 in [urad]
+    double getKinkWidth(double materialbudget) const;
+
+    // Return material budget x/X0 and its uncertainty for a measured kink width and its uncertainty in [urad]
+    std::pair<double,double> getMaterialBudget(double width, double width_error = 0.) const;
+
+    // Convert a map of measured kink widths with uncertainties in [urad] into maps of x/X0 and
+    // their uncertainties. Widths below the kink resolution yield zero material, widths beyond
+    // the table range yield NaN, as do all cells if the two input maps differ in size.
+    void invert(const map2d& widths, const map2d& width_errors,
+                map2d& materialbudget, map2d& materialbudget_errors) const;
+
+  private:
+    double m_beamEnergy;
+    double m_totalMaterialBudget;
+    double m_kinkResolution;
+
+    // Table of x/X0 at equidistant kink widths starting from the kink resolution:
+    double m_widthMin;
+    double m_widthMax;
+    double m_invBinWidth;
+    std::vector<double> m_table;
+  };
+
+}
+
+#endif /* IMAGING_H */
@@ -0,0 +1,31 @@
+#ifndef MAP2D_H
+#define MAP2D_H
+
+#include <vector>
+#include <cstddef>
+
+namespace gblsim {
+
+  // Regular grid of values across a plane, stored row by row.
+  // Cell (ix,iy) covers [xmin + ix*pitch_x, xmin + (ix+1)*pitch_x) in x, same for y, all in [mm].
+  struct map2d {
+    map2d(size_t nx = 0, size_t ny = 0, double value = 0.,
+          double xmin = 0., double ymin = 0., double pitch_x = 1., double pitch_y = 1.) :
+      nx(nx), ny(ny), xmin(xmin), ymin(ymin), pitch_x(pitch_x), pitch_y(pitch_y), values(nx*ny, value) {}
+
+    double& operator()(size_t ix, size_t iy) { return values[iy*nx + ix]; }
+    double operator()(size_t ix, size_t iy) const { return values[iy*nx + ix]; }
+
+    // Centre of the cell in [mm]:
+    double x(size_t ix) const { return xmin + (ix + 0.5)*pitch_x; }
+    double y(size_t iy) const { return ymin + (iy + 0.5)*pitch_y; }
+
+    size_t nx, ny;
+    double xmin, ymin;
+    double pitch_x, pitch_y;
+    std::vector<double> values;
+  };
+
+}
+
+#endif /* MAP2D_H */
@@ -0,0 +1,174 @@
+// Resolution for planes with a discrete distribution of states
+
+#include "mixture.h"
+#include "trackmodel.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace gblsim;
+using namespace unilog;
+
+namespace {
+  // Weight of a state in the track fit:
+  double weight(const state& st) { return (st.hit() ? 1./(st.resolution*st.resolution) : 0.); }
+}
+
+// Covariance of the track positions at all measurement planes and the evaluated plane (last row)
+// for every depth of the descent, and the states of the measurement planes
+struct mixture::branch {
+  std::vector<Eigen::MatrixXd> covariance;
+  std::vector<std::vector<state>> states;
+  std::vector<double> base;
+  std::vector<std::pair<double,double>> outcomes;
+};
+
+double distribution::mean() const {
+  double sum = 0, norm = 0;
+  for(const auto& o : outcomes) {
+    sum += o.first*o.second;
+    norm += o.second;
+  }
+  return (norm > 0. ? sum/norm : 0.);
+}
+
+double distribution::quantile(double fraction) const {
+  double norm = 0;
+  for(const auto& o : outcomes) norm += o.second;
+  double cumulative = 0;
+  for(const auto& o : outcomes) {
+    cumulative += o.second;
+    if(cumulative >= fraction*norm) return o.first;
+  }
+  return (outcomes.empty() ? 0. : outcomes.back().first);
+}
+
+mixture::mixture(std::vector<plane> planes, double beam_energy, double material) :
+  m_planes(planes),
+  m_beamEnergy(beam_energy),
+  m_volumeMaterial(material),
+  m_threshold(1e-6),
+  m_states(planes.size())
+{
+  // Planes are indexed in z order, as in the telescope:
+  std::stable_sort(m_planes.begin(), m_planes.end());
+}
+
+void mixture::setStates(int plane, std::vector<state> states) {
+  if(plane < 0 || plane >= static_cast<int>(m_planes.size())) {
+    LOG(logERROR) << "Plane " << plane << " does not exist, cannot set its states.";
+    return;
+  }
+  double norm = 0;
+  for(const auto& st : states) norm += st.probability;
+  if(!(norm > 0.)) {
+    LOG(logERROR) << "States of plane " << plane << " have no probability.";
+    return;
+  }
+  for(auto& st : states) st.probability /= norm;
+  m_states.at(plane) = states;
+}
+
+void mixture::descend(branch& current, size_t depth, double probability, distribution& result) const {
+
+  const Eigen::MatrixXd& covariance = current.covariance.at(depth);
+
+  // All plane states chosen, the last row belongs to the evaluated plane:
+  if(depth == current.states.size()) {
+    current.outcomes.push_back(std::make_pair(std::sqrt(covariance(depth, depth))*1E3, probability));
+    return;
+  }
+
+  for(const auto& st : current.states.at(depth)) {
+    double p = probability*st.probability;
+    if(p < m_threshold) {
+      result.pruned += p;
+      continue;
+    }
+
+    double delta = weight(st) - current.base.at(depth);
+    if(delta == 0.) {
+      current.covariance.at(depth+1) = covariance;
+      descend(current, depth+1, p, result);
+      continue;
+    }
+
+    // Rank-one update of the covariance for the changed weight of this plane. All states have
+    // at most the weight of the best state, so a vanishing denominator means the track cannot
+    // be reconstructed in this branch:
+    double denominator = 1. + delta*covariance(depth, depth);
+    if(denominator < 1e-9) {
+      result.untracked += p;
+      continue;
+    }
+    current.covariance.at(depth+1) = covariance - delta/denominator*covariance.col(depth)*covariance.row(depth);
+    descend(current, depth+1, p, result);
+  }
+}
+
+distribution mixture::evaluate(int plane) const {
+
+  distribution result;
+  result.untracked = 0;
+  result.pruned = 0;
+  if(plane < 0 || plane >= static_cast<int>(m_planes.size())) {
+    LOG(logERROR) << "Plane " << plane << " does not exist.";
+    return result;
+  }
+
+  // Set up the track model with the best state of every measurement plane:
+  branch current;
+  std::vector<size_t> index;
+  std::vector<layer<double>> layers;
+  unsigned int hits = 0;
+  for(size_t p = 0; p < m_planes.size(); p++) {
+    layer<double> l(m_planes.at(p));
+    std::vector<state> states = m_states.at(p);
+    if(states.empty() && l.measurement) states.push_back(state(1., l.resolution));
+    if(!states.empty()) {
+      const state& best = *std::max_element(states.begin(), states.end(), [](const state& a, const state& b) {
+          return weight(a) < weight(b);
+        });
+      l.measurement = best.hit();
+      l.resolution = best.resolution;
+      hits += best.hit();
+      index.push_back(p);
+      current.states.push_back(states);
+      current.base.push_back(weight(best));
+    }
+    layers.push_back(l);
+  }
+  if(hits < 2) {
+    LOG(logERROR) << "Less than two planes can be hit, no track can be reconstructed.";
+    result.untracked = 1.;
+    return result;
+  }
+  index.push_back(plane);
+
+  trackmodel<double> model(layers, m_beamEnergy, m_volumeMaterial);
+  Eigen::MatrixXd covariance(index.size(), index.size());
+  for(size_t i = 0; i < index.size(); i++) {
+    for(size_t j = 0; j <= i; j++) {
+      covariance(i, j) = covariance(j, i) = model.getCovariance(index.at(i), index.at(j));
+    }
+  }
+  current.covariance.assign(current.states.size() + 1, covariance);
+
+  descend(current, 0, 1., result);
+
+  // Merge identical resolutions:
+  std::sort(current.outcomes.begin(), current.outcomes.end());
+  for(const auto& o : current.outcomes) {
+    if(!result.outcomes.empty() && o.first - result.outcomes.back().first <= 1e-9*o.first) {
+      result.outcomes.back().second += o.second;
+    }
+    else {
+      result.outcomes.push_back(o);
+    }
+  }
+
+  LOG(logINFO) << "Evaluated " << current.outcomes.size() << " combinations of plane states, "
+               << result.outcomes.size() << " distinct resolutions";
+  return result;
+}
@@ -0,0 +1,71 @@
+#ifndef MIXTURE_H
+#define MIXTURE_H
+
+#include <utility>
+#include <vector>
+
+#include "assembly.h"
+
+namespace gblsim {
+
+  // Possible state of a plane when a particle passes, e.g. a cluster size with its resolution
+  struct state {
+    state(double probability, double resolution) : probability(probability), resolution(resolution) {}
+    // State without a hit on the plane
+    static state miss(double probability) { return state(probability, 0.); }
+    bool hit() const { return resolution > 0.0; }
+    double probability;
+    // Intrinsic resolution [mm]
+    double resolution;
+  };
+
+  // Distribution of the track resolution over all state combinations
+  struct distribution {
+    // Possible resolutions [um] with their probabilities, ascending in resolution
+    std::vector<std::pair<double,double>> outcomes;
+    // Probability of too few hits to reconstruct the track
+    double untracked;
+    // Probability of the combinations dropped as negligible
+    double pruned;
+
+    // Mean resolution of reconstructed tracks [um]
+    double mean() const;
+    // Resolution below which the given fraction of reconstructed tracks lies [um]
+    double quantile(double fraction) const;
+  };
+
+  // Track resolution for planes with a discrete distribution of states.
+  //
+  // Every measurement plane is either hit with one of several resolutions, e.g. depending on the
+  // cluster size, or missed. The resolution at a plane is evaluated for all combinations of plane
+  // states. The track model is set up once with the best state of every plane, and the covariance
+  // between all measurement planes and the evaluated plane is updated with one rank-one correction
+  // per changed plane while descending through the combinations. Branches with a probability
+  // below the threshold are dropped. Resolutions are evaluated along the first dimension.
+  class mixture {
+  public:
+    mixture(std::vector<plane> planes, double beam_energy, double material = X0_Air);
+
+    // Set the states of the plane (index in the z-ordered planes), probabilities are normalized.
+    // Measurement planes without states are always hit with their intrinsic resolution.
+    void setStates(int plane, std::vector<state> states);
+    // Minimum probability of a combination of states to be evaluated
+    void setThreshold(double threshold) { m_threshold = threshold; }
+
+    // Distribution of the resolution at the given plane (index in the z-ordered planes)
+    distribution evaluate(int plane) const;
+
+  private:
+    struct branch;
+    void descend(branch& current, size_t depth, double probability, distribution& result) const;
+
+    std::vector<plane> m_planes;
+    double m_beamEnergy;
+    double m_volumeMaterial;
+    double m_threshold;
+    std::vector<std::vector<state>> m_states;
+  };
+
+}
+
+#endif /* MIXTURE_H */
@@ -0,0 +1,219 @@
+// Telescope layout optimization
+
+#include "optimizer.h"
+#include "trackmodel.h"
+#include "log.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace gblsim;
+using namespace unilog;
+
+namespace {
+  // Derivatives with respect to at most max_movable plane positions, stored without heap allocation:
+  typedef Eigen::Matrix<double, Eigen::Dynamic, 1, 0, optimizer::max_movable, 1> derivatives;
+  typedef Eigen::AutoDiffScalar<derivatives> scalar;
+
+  // Penalty per squared violation of the minimum spacing [1/mm^2]:
+  const double spacing_penalty = 1e3;
+  // Violations of windows and spacings tolerated for a feasible layout [mm]:
+  const double feasibility_tolerance = 1e-3;
+}
+
+optimizer::optimizer(std::vector<plane> planes, double beam_energy, double material) :
+  m_planes(planes),
+  m_beamEnergy(beam_energy),
+  m_volumeMaterial(material),
+  m_spacing(0.),
+  m_movable(),
+  m_targets()
+{
+  // Planes are indexed in z order, as in the telescope:
+  std::stable_sort(m_planes.begin(), m_planes.end());
+}
+
+void optimizer::setMovable(int plane, double zmin, double zmax) {
+  if(plane < 0 || plane >= static_cast<int>(m_planes.size())) {
+    LOG(logERROR) << "Plane " << plane << " does not exist, cannot make it movable.";
+    return;
+  }
+  if(m_movable.size() >= static_cast<size_t>(max_movable)) {
+    LOG(logERROR) << "At most " << max_movable << " planes can be movable, ignoring plane " << plane;
+    return;
+  }
+  window w;
+  w.plane = plane;
+  w.zmin = std::min(zmin, zmax);
+  w.zmax = std::max(zmin, zmax);
+  m_movable.push_back(w);
+}
+
+std::vector<plane> optimizer::getPlanes(const std::vector<double>& positions) const {
+  std::vector<plane> planes = m_planes;
+  for(size_t m = 0; m < m_movable.size(); m++) {
+    planes.at(m_movable.at(m).plane).setPosition(positions.at(m));
+  }
+  return planes;
+}
+
+double optimizer::getObjective(const std::vector<double>& positions, std::vector<double>& gradient) const {
+
+  // Seed the derivatives with respect to all movable plane positions:
+  const size_t n = m_movable.size();
+  std::vector<layer<scalar>> layers;
+  for(const auto& pl : m_planes) {
+    layer<scalar> l(pl);
+    l.position.derivatives() = derivatives::Zero(n);
+    l.material.derivatives() = derivatives::Zero(n);
+    l.resolution.derivatives() = derivatives::Zero(n);
+    layers.push_back(l);
+  }
+  for(size_t m = 0; m < n; m++) {
+    layers.at(m_movable.at(m).plane).position = scalar(positions.at(m), derivatives::Unit(n, m));
+  }
+
+  trackmodel<scalar> model(layers, scalar(m_beamEnergy, derivatives::Zero(n)), m_volumeMaterial);
+
+  scalar objective(0., derivatives::Zero(n));
+  for(const auto& term : m_targets) {
+    if(term.kink) objective += term.weight*sqrt(model.getKinkVariance(term.plane))*1E6;
+    else objective += term.weight*sqrt(model.getVariance(term.plane))*1E3;
+  }
+
+  gradient.resize(n);
+  for(size_t m = 0; m < n; m++) gradient.at(m) = (objective.derivatives().size() > 0 ? objective.derivatives()(m) : 0.);
+  return objective.value();
+}
+
+double optimizer::getPenalized(const std::vector<double>& positions, std::vector<double>& gradient) const {
+
+  double objective = getObjective(positions, gradient);
+  if(m_spacing <= 0.0) return objective;
+
+  // Index of the movable entry for every plane:
+  std::vector<int> movable(m_planes.size(), -1);
+  for(size_t m = 0; m < m_movable.size(); m++) movable.at(m_movable.at(m).plane) = m;
+
+  std::vector<plane> planes = getPlanes(positions);
+  std::vector<size_t> order(planes.size());
+  for(size_t p = 0; p < order.size(); p++) order.at(p) = p;
+  std::sort(order.begin(), order.end(), [&planes](size_t a, size_t b) { return planes.at(a) < planes.at(b); });
+
+  // Quadratic penalty for neighbours closer than the minimum spacing:
+  for(size_t o = 1; o < order.size(); o++) {
+    double violation = m_spacing - (planes.at(order.at(o)).position() - planes.at(order.at(o-1)).position());
+    if(violation <= 0.0) continue;
+    objective += spacing_penalty*violation*violation;
+    if(movable.at(order.at(o)) >= 0) gradient.at(movable.at(order.at(o))) -= 2*spacing_penalty*violation;
+    if(movable.at(order.at(o-1)) >= 0) gradient.at(movable.at(order.at(o-1))) += 2*spacing_penalty*violation;
+  }
+  return objective;
+}
+
+bool optimizer::isFeasible(const std::vector<double>& positions) const {
+  for(size_t m = 0; m < m_movable.size(); m++) {
+    if(positions.at(m) < m_movable.at(m).zmin - feasibility_tolerance || positions.at(m) > m_movable.at(m).zmax + feasibility_tolerance) return false;
+  }
+  std::vector<plane> planes = getPlanes(positions);
+  std::sort(planes.begin(), planes.end());
+  for(size_t p = 1; p < planes.size(); p++) {
+    if(planes.at(p).position() - planes.at(p-1).position() < m_spacing - feasibility_tolerance) return false;
+  }
+  return true;
+}
+
+layout optimizer::descend(std::vector<double> positions) const {
+
+  const size_t n = m_movable.size();
+  std::vector<double> gradient, trial_gradient, trial(n);
+  double objective = getPenalized(positions, gradient);
+
+  // Initial step moves by at most a tenth of the smallest window:
+  double width = 1e9;
+  for(const auto& w : m_movable) width = std::min(width, std::max(w.zmax - w.zmin, feasibility_tolerance));
+  double gmax = 0;
+  for(auto g : gradient) gmax = std::max(gmax, std::fabs(g));
+  double step = (gmax > 0. ? 0.1*width/gmax : 0.);
+
+  unsigned int it = 0;
+  for(; it < 500 && step > 0.; it++) {
+    // Backtracking line search along the projected gradient (Armijo condition):
+    bool accepted = false;
+    double trial_objective = objective, move = 0;
+    for(int halving = 0; halving < 40; halving++) {
+      double decrease = 0;
+      move = 0;
+      for(size_t m = 0; m < n; m++) {
+        trial.at(m) = std::min(std::max(positions.at(m) - step*gradient.at(m), m_movable.at(m).zmin), m_movable.at(m).zmax);
+        decrease += gradient.at(m)*(positions.at(m) - trial.at(m));
+        move = std::max(move, std::fabs(positions.at(m) - trial.at(m)));
+      }
+      trial_objective = getPenalized(trial, trial_gradient);
+      if(trial_objective <= objective - 1e-4*decrease) {
+        accepted = true;
+        break;
+      }
+      step *= 0.5;
+    }
+    if(!accepted) break;
+
+    // Barzilai-Borwein estimate of the next step length from the change of the gradient:
+    double ss = 0, sy = 0;
+    for(size_t m = 0; m < n; m++) {
+      ss += (trial.at(m) - positions.at(m))*(trial.at(m) - positions.at(m));
+      sy += (trial.at(m) - positions.at(m))*(trial_gradient.at(m) - gradient.at(m));
+    }
+
+    double improvement = objective - trial_objective;
+    positions = trial;
+    gradient = trial_gradient;
+    objective = trial_objective;
+    LOG(logDEBUG2) << "Iteration " << it << ": objective " << objective << ", step " << step;
+
+    if(move < 1e-6 || improvement < 1e-9*std::fabs(objective)) break;
+    step = (sy > 0. ? ss/sy : 2*step);
+  }
+
+  layout result;
+  result.planes = getPlanes(positions);
+  result.objective = getObjective(positions, gradient);
+  result.feasible = isFeasible(positions);
+  result.iterations = it;
+  return result;
+}
+
+layout optimizer::optimize(unsigned int starts, unsigned int seed) const {
+
+  LOG(logINFO) << "Optimizing " << m_movable.size() << " plane positions for " << m_targets.size()
+               << " objective terms from " << starts << " starting points";
+
+  std::vector<layout> results(std::max(starts, 1u));
+  threadpool::global().parallel_for(results.size(), [this, &results, seed](size_t s) {
+      std::vector<double> positions(m_movable.size());
+      std::mt19937 generator(seed + s);
+      for(size_t m = 0; m < m_movable.size(); m++) {
+        const window& w = m_movable.at(m);
+        if(s == 0) {
+          // First start from the given layout:
+          positions.at(m) = std::min(std::max(m_planes.at(w.plane).position(), w.zmin), w.zmax);
+        }
+        else {
+          positions.at(m) = std::uniform_real_distribution<double>(w.zmin, w.zmax)(generator);
+        }
+      }
+      results.at(s) = descend(positions);
+      LOG(logDEBUG) << "Start " << s << ": objective " << results.at(s).objective << " after "
+                    << results.at(s).iterations << " iterations" << (results.at(s).feasible ? "" : " (infeasible)");
+    });
+
+  // Best feasible result, if any:
+  layout best = results.front();
+  for(const auto& r : results) {
+    if((r.feasible && !best.feasible) || (r.feasible == best.feasible && r.objective < best.objective)) best = r;
+  }
+  LOG(logINFO) << "Best layout: objective " << best.objective << (best.feasible ? "" : " (infeasible)");
+  return best;
+}
@@ -0,0 +1,78 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <vector>
+
+#include "assembly.h"
+
+namespace gblsim {
+
+  // Term of the layout objective: weighted resolution [um] or kink resolution [urad] at a plane
+  struct target {
+    target(int plane, double weight = 1., bool kink = false) : plane(plane), weight(weight), kink(kink) {}
+    int plane;
+    double weight;
+    bool kink;
+  };
+
+  // Result of a layout optimization
+  struct layout {
+    // Planes in the order given to the optimizer, with optimized positions
+    std::vector<plane> planes;
+    double objective;
+    // Whether all windows and minimum spacings are respected
+    bool feasible;
+    unsigned int iterations;
+  };
+
+  // Optimization of plane positions for the best resolution along the first dimension.
+  //
+  // Planes are referred to by their index in the z-ordered initial layout. Movable planes
+  // are confined to z-windows, and all neighbouring planes have to keep a minimum spacing. The
+  // objective is a weighted sum of resolutions and kink resolutions, minimized by projected gradient
+  // descent with exact gradients from the native track model. Several starts, the first from the
+  // given layout and all others from random positions within the windows, run in parallel.
+  class optimizer {
+  public:
+    optimizer(std::vector<plane> planes, double beam_energy, double material = X0_Air);
+
+    // Maximum number of movable planes
+    static const int max_movable = 16;
+
+    // Allow the plane to move within [zmin, zmax]
+    void setMovable(int plane, double zmin, double zmax);
+    // Minimum distance between any two planes in [mm]
+    void setMinimumSpacing(double spacing) { m_spacing = spacing; }
+    // Add a term to the objective
+    void addTarget(const target& term) { m_targets.push_back(term); }
+
+    // Objective for the given positions of the movable planes, and its gradient
+    double getObjective(const std::vector<double>& positions, std::vector<double>& gradient) const;
+    // Minimize the objective from several starting points
+    layout optimize(unsigned int starts = 16, unsigned int seed = 0) const;
+
+  private:
+    // Objective including the penalty for violated minimum spacings
+    double getPenalized(const std::vector<double>& positions, std::vector<double>& gradient) const;
+    // Descend from one starting point
+    layout descend(std::vector<double> positions) const;
+    std::vector<plane> getPlanes(const std::vector<double>& positions) const;
+    bool isFeasible(const std::vector<double>& positions) const;
+
+    std::vector<plane> m_planes;
+    double m_beamEnergy;
+    double m_volumeMaterial;
+    double m_spacing;
+
+    struct window {
+      int plane;
+      double zmin;
+      double zmax;
+    };
+    std::vector<window> m_movable;
+    std::vector<target> m_targets;
+  };
+
+}
+
+#endif /* OPTIMIZER_H */
@@ -0,0 +1,189 @@
+// Asynchronous output of result records
+
+#include "pipeline.h"
+#include "log.h"
+
+#include <chrono>
+#include <cstring>
+
+using namespace gblsim;
+using namespace unilog;
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  size_t nanoseconds(clock_type::time_point start, clock_type::time_point stop) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+  }
+}
+
+pipeline::pipeline(std::vector<std::string> columns, size_t capacity) :
+  m_columns(columns),
+  m_mask(0),
+  m_slots(),
+  m_values(),
+  m_sinks(),
+  m_enqueue(0),
+  m_dequeue(0),
+  m_closing(false),
+  m_started(false),
+  m_pushers(0),
+  m_complete(false),
+  m_pushed(0),
+  m_stalls(0),
+  m_stallTime(0),
+  m_batches(0),
+  m_sinkTime(),
+  m_sinkFailures(),
+  m_good(true)
+{
+  size_t size = 2;
+  while(size < capacity) size *= 2;
+  m_mask = size - 1;
+  m_slots.reset(new slot[size]);
+  for(size_t s = 0; s < size; s++) m_slots[s].sequence.store(s, std::memory_order_relaxed);
+  m_values.resize(size*m_columns.size());
+}
+
+pipeline::~pipeline() {
+  close();
+}
+
+bool pipeline::addSink(std::unique_ptr<sink> output) {
+  if(m_started || m_closing) {
+    LOG(logERROR) << "Sinks have to be added before the first record.";
+    return false;
+  }
+  if(!output || output->getColumns() != m_columns) {
+    LOG(logERROR) << "Sink does not match the columns of the pipeline.";
+    return false;
+  }
+  m_sinks.push_back(std::move(output));
+  m_sinkTime.push_back(0);
+  m_sinkFailures.push_back(0);
+  return true;
+}
+
+bool pipeline::enqueue(const double* record) {
+  // Bounded multi-producer queue: a slot is free for position pos if its sequence equals pos,
+  // and holds the record of position pos once its sequence is pos + 1.
+  size_t pos = m_enqueue.load(std::memory_order_relaxed);
+  slot* s;
+  while(true) {
+    s = &m_slots[pos & m_mask];
+    size_t sequence = s->sequence.load(std::memory_order_acquire);
+    if(sequence == pos) {
+      if(m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+    }
+    else if(sequence < pos) return false;
+    else pos = m_enqueue.load(std::memory_order_relaxed);
+  }
+  std::memcpy(&m_values[(pos & m_mask)*m_columns.size()], record, m_columns.size()*sizeof(double));
+  s->sequence.store(pos + 1, std::memory_order_release);
+  m_pushed++;
+  return true;
+}
+
+bool pipeline::tryPush(const std::vector<double>& record) {
+  if(record.size() != m_columns.size()) {
+    LOG(logERROR) << "Record with " << record.size() << " values for " << m_columns.size() << " columns.";
+    return false;
+  }
+
+  m_pushers++;
+  bool queued = false;
+  if(!m_closing) {
+    // The writer starts with the first record, when all sinks are known:
+    if(!m_started.exchange(true)) m_writer = std::thread(&pipeline::write, this);
+    queued = enqueue(record.data());
+  }
+  m_pushers--;
+  return queued;
+}
+
+bool pipeline::push(const std::vector<double>& record) {
+  if(tryPush(record)) return true;
+  if(record.size() != m_columns.size()) return false;
+
+  // Queue is full, wait for the writer unless the pipeline is closed meanwhile:
+  m_pushers++;
+  clock_type::time_point start = clock_type::now();
+  bool queued = false;
+  while(!m_closing && !(queued = enqueue(record.data()))) std::this_thread::yield();
+  m_pushers--;
+  if(!queued) return false;
+  m_stalls++;
+  m_stallTime += nanoseconds(start, clock_type::now());
+  return true;
+}
+
+void pipeline::write() {
+  std::vector<double> batch;
+  const size_t width = m_columns.size();
+  std::vector<double> record(width);
+
+  while(true) {
+    // Take all queued records, the sinks are only called outside of the queue:
+    bool closing = m_complete.load(std::memory_order_acquire);
+    batch.clear();
+    while(true) {
+      slot& s = m_slots[m_dequeue & m_mask];
+      if(s.sequence.load(std::memory_order_acquire) != m_dequeue + 1) break;
+      const double* values = &m_values[(m_dequeue & m_mask)*width];
+      batch.insert(batch.end(), values, values + width);
+      s.sequence.store(m_dequeue + m_mask + 1, std::memory_order_release);
+      m_dequeue++;
+    }
+
+    if(batch.empty()) {
+      if(closing) break;
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+      continue;
+    }
+
+    m_batches++;
+    for(size_t o = 0; o < m_sinks.size(); o++) {
+      clock_type::time_point start = clock_type::now();
+      for(size_t r = 0; r < batch.size(); r += width) {
+        record.assign(batch.begin() + r, batch.begin() + r + width);
+        if(!m_sinks[o]->write(record)) m_sinkFailures[o]++;
+      }
+      m_sinkTime[o] += nanoseconds(start, clock_type::now());
+    }
+  }
+}
+
+bool pipeline::close() {
+  if(m_closing.exchange(true)) return m_good;
+  clock_type::time_point start = clock_type::now();
+  // Records of producers which passed the check of m_closing are queued before the last batch:
+  while(m_pushers > 0) std::this_thread::yield();
+  m_complete = true;
+  if(m_writer.joinable()) m_writer.join();
+
+  for(size_t o = 0; o < m_sinks.size(); o++) {
+    clock_type::time_point flush = clock_type::now();
+    m_sinks[o]->flush();
+    m_sinkTime[o] += nanoseconds(flush, clock_type::now());
+  }
+  LOG(logINFO) << "Pipeline: " << m_pushed << " records in " << m_batches << " batches, " << m_stalls
+               << " pushes waited " << m_stallTime*1e-9 << "s for the writer, draining took "
+               << nanoseconds(start, clock_type::now())*1e-9 << "s";
+  for(size_t o = 0; o < m_sinks.size(); o++) {
+    double seconds = m_sinkTime[o]*1e-9;
+    LOG(logINFO) << "Sink " << o << ": " << seconds << "s, "
+                 << (seconds > 0 ? m_pushed/seconds : 0.) << " records/s";
+    // Failed writes, e.g. on a full disk, or a sink which failed while flushing:
+    if(m_sinkFailures[o] > 0 || !m_sinks[o]->good()) {
+      if(m_sinkFailures[o] > 0) {
+        LOG(logERROR) << "Sink " << o << " failed, " << m_sinkFailures[o] << " of " << m_pushed << " records not written";
+      }
+      else {
+        LOG(logERROR) << "Sink " << o << " failed while flushing";
+      }
+      m_good = false;
+    }
+  }
+  m_sinks.clear();
+  return m_good;
+}
@@ -0,0 +1,81 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "results.h"
+
+namespace gblsim {
+
+  // Output stage decoupled from the computation.
+  //
+  // Compute threads push records into a bounded lock-free queue, and a dedicated writer thread
+  // drains it in batches into all sinks, so fills on the compute threads never wait for I/O.
+  // While the writer is busy with one batch, the queue collects the next one. If the writer falls
+  // behind and the queue is full, push() waits for free space (back-pressure), while tryPush()
+  // returns immediately. Throughput of both stages is reported when the pipeline is closed.
+  class pipeline {
+  public:
+    // Records have one value per column, the capacity is rounded up to a power of two
+    pipeline(std::vector<std::string> columns, size_t capacity = 65536);
+    ~pipeline();
+
+    // Add a sink for the same columns, before the first record is pushed
+    bool addSink(std::unique_ptr<sink> output);
+
+    // Queue a record, waiting for free space if the writer falls behind. Thread-safe, returns false
+    // without queueing the record once the pipeline is closed.
+    bool push(const std::vector<double>& record);
+    // Queue a record if there is free space. Thread-safe.
+    bool tryPush(const std::vector<double>& record);
+
+    // Wait for pushes in progress, write all queued records, flush and close the sinks and report
+    // the throughput. Returns false if any sink failed to write.
+    bool close();
+
+  private:
+    struct slot {
+      std::atomic<size_t> sequence;
+    };
+
+    // Copy the record into the next free slot, returns false if the queue is full
+    bool enqueue(const double* record);
+    // Writer thread: move queued records into a batch and hand it to the sinks
+    void write();
+
+    std::vector<std::string> m_columns;
+    size_t m_mask;
+    std::unique_ptr<slot[]> m_slots;
+    std::vector<double> m_values;
+    std::vector<std::unique_ptr<sink>> m_sinks;
+
+    // Queue positions, on separate cache lines:
+    alignas(64) std::atomic<size_t> m_enqueue;
+    alignas(64) size_t m_dequeue;
+    alignas(64) std::atomic<bool> m_closing;
+    std::atomic<bool> m_started;
+    // Producers between the check of m_closing and their enqueue, close() waits for them before
+    // the writer takes the last records:
+    alignas(64) std::atomic<size_t> m_pushers;
+    std::atomic<bool> m_complete;
+
+    // Statistics of the compute side:
+    std::atomic<size_t> m_pushed;
+    std::atomic<size_t> m_stalls;
+    std::atomic<size_t> m_stallTime;
+    // Statistics of the writer, time per sink in [ns]:
+    size_t m_batches;
+    std::vector<size_t> m_sinkTime;
+    // Failed writes per sink, and whether all sinks succeeded:
+    std::vector<size_t> m_sinkFailures;
+    bool m_good;
+
+    std::thread m_writer;
+  };
+
+}
+
+#endif /* PIPELINE_H */
@@ -35,14 +35,22 @@ Eigen::Vector2d gblsim::getScatterer(double energy, double radlength, double tot
 // construct a GblPoint with a scatterer and a measurement
 gbl::GblPoint gblsim::getPoint(double dz, const Eigen::Vector2d& res, const Eigen::Vector2d& wscat) {
 
-  // Propagate:
-  auto jacPointToPoint = Jac5(dz);
-  gbl::GblPoint point(jacPointToPoint);
+  gbl::GblPoint point = getMeasurement(dz, res);
 
   // Add scatterer:
   Eigen::Vector2d scat(0., 0.);
   point.addScatterer(scat, wscat);
-  
+
+  return point;
+}
+
+// construct a GblPoint with only a measurement
+gbl::GblPoint gblsim::getMeasurement(double dz, const Eigen::Vector2d& res) {
+
+  // Propagate:
+  auto jacPointToPoint = Jac5(dz);
+  gbl::GblPoint point(jacPointToPoint);
+
   // Add measurement:
   // measurement = residual
   Eigen::Vector2d meas;
@@ -1,5 +1,3 @@
-#include "TMatrixD.h"
-#include "TVectorD.h"
 #include "GblTrajectory.h"
 #include "GblData.h"
 
@@ -11,6 +9,8 @@ namespace gblsim {
   gbl::GblPoint getPoint(double dz, double res, const Eigen::Vector2d& wscat);
   gbl::GblPoint getPoint(double dz, const Eigen::Vector2d& res, const Eigen::Vector2d& wscat);
   gbl::GblPoint getPoint(double dz, const Eigen::Vector2d& wscat);
+  // Point with a measurement but without scatterer, a scatterer without precision is a free kink
+  gbl::GblPoint getMeasurement(double dz, const Eigen::Vector2d& res);
   gbl::GblPoint getMarker(double dz);
 
 }
@@ -0,0 +1,302 @@
+// Result sinks for scans and Monte Carlo studies
+
+#include "results.h"
+#include "log.h"
+
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef GBLSIM_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace gblsim;
+using namespace unilog;
+
+namespace {
+  const char column_magic[] = "GBLCOL01";
+
+  size_t padded(size_t size) { return (size + 7)/8*8; }
+}
+
+columnwriter::columnwriter(const std::string& filename, std::vector<std::string> columns, size_t chunk, bool compress) :
+  sink(columns),
+  m_file(filename.c_str(), std::ios::binary),
+  m_chunk(chunk > 0 ? chunk : 1),
+  m_compress(compress),
+  m_good(true),
+  m_buffer(columns.size())
+{
+#ifndef GBLSIM_ZLIB
+  if(m_compress) {
+    LOG(logWARNING) << "Compiled without zlib, writing " << filename << " uncompressed.";
+    m_compress = false;
+  }
+#endif
+  if(!m_file) {
+    LOG(logERROR) << "Cannot write to " << filename;
+    m_good = false;
+    return;
+  }
+
+  m_file.write(column_magic, 8);
+  writeWords(std::vector<uint64_t>(1, m_columns.size()));
+  for(const auto& name : m_columns) {
+    writeWords(std::vector<uint64_t>(1, name.size()));
+    writePadded(name.data(), name.size());
+  }
+  for(auto& column : m_buffer) column.reserve(m_chunk);
+}
+
+columnwriter::~columnwriter() {
+  flush();
+}
+
+void columnwriter::writeWords(const std::vector<uint64_t>& words) {
+  m_file.write(reinterpret_cast<const char*>(words.data()), words.size()*sizeof(uint64_t));
+}
+
+void columnwriter::writePadded(const char* data, size_t size) {
+  static const char zeros[8] = {0};
+  m_file.write(data, size);
+  m_file.write(zeros, padded(size) - size);
+}
+
+bool columnwriter::write(const std::vector<double>& record) {
+  if(!m_good) return false;
+  if(record.size() != m_columns.size()) {
+    LOG(logERROR) << "Record with " << record.size() << " values for " << m_columns.size() << " columns.";
+    return false;
+  }
+  for(size_t c = 0; c < record.size(); c++) m_buffer[c].push_back(record[c]);
+  if(m_buffer.front().size() >= m_chunk) flush();
+  return m_good;
+}
+
+void columnwriter::flush() {
+  if(!m_good || m_buffer.empty() || m_buffer.front().empty()) return;
+
+  size_t records = m_buffer.front().size();
+  std::vector<std::string> stored(m_buffer.size());
+  std::vector<uint64_t> header;
+  header.push_back(records);
+  header.push_back(m_compress ? 1 : 0);
+  for(size_t c = 0; c < m_buffer.size(); c++) {
+    const char* raw = reinterpret_cast<const char*>(m_buffer[c].data());
+    size_t size = records*sizeof(double);
+#ifdef GBLSIM_ZLIB
+    if(m_compress) {
+      uLongf length = compressBound(size);
+      stored[c].resize(length);
+      if(compress2(reinterpret_cast<Bytef*>(&stored[c][0]), &length, reinterpret_cast<const Bytef*>(raw), size, Z_BEST_SPEED) != Z_OK) {
+        LOG(logERROR) << "Compression of column " << m_columns[c] << " failed.";
+        m_good = false;
+        return;
+      }
+      stored[c].resize(length);
+    }
+    else stored[c].assign(raw, size);
+#else
+    stored[c].assign(raw, size);
+#endif
+    header.push_back(stored[c].size());
+  }
+
+  writeWords(header);
+  for(const auto& column : stored) writePadded(column.data(), column.size());
+  m_file.flush();
+  if(!m_file) {
+    LOG(logERROR) << "Writing columnar file failed.";
+    m_good = false;
+  }
+  for(auto& column : m_buffer) column.clear();
+}
+
+textwriter::textwriter(const std::string& filename, std::vector<std::string> columns, bool json) :
+  sink(columns), m_file(filename.c_str()), m_json(json), m_good(true) {
+  if(!m_file) {
+    LOG(logERROR) << "Cannot write to " << filename;
+    m_good = false;
+    return;
+  }
+  // Enough digits to read back every double exactly:
+  m_file << std::setprecision(std::numeric_limits<double>::max_digits10);
+  if(m_json) return;
+  for(size_t c = 0; c < m_columns.size(); c++) m_file << (c > 0 ? "," : "") << m_columns[c];
+  m_file << "\n";
+}
+
+bool textwriter::write(const std::vector<double>& record) {
+  if(!m_good) return false;
+  if(record.size() != m_columns.size()) {
+    LOG(logERROR) << "Record with " << record.size() << " values for " << m_columns.size() << " columns.";
+    return false;
+  }
+  if(m_json) {
+    m_file << "{";
+    for(size_t c = 0; c < record.size(); c++) {
+      m_file << (c > 0 ? ", \"" : "\"") << m_columns[c] << "\": ";
+      // JSON has no representation for infinities and NaN:
+      if(std::isfinite(record[c])) m_file << record[c];
+      else m_file << "null";
+    }
+    m_file << "}\n";
+  }
+  else {
+    for(size_t c = 0; c < record.size(); c++) m_file << (c > 0 ? "," : "") << record[c];
+    m_file << "\n";
+  }
+  m_good = static_cast<bool>(m_file);
+  return m_good;
+}
+
+std::unique_ptr<sink> gblsim::openSink(const std::string& filename, std::vector<std::string> columns, bool compress) {
+  auto ends = [&filename](const std::string& suffix) {
+    return filename.size() >= suffix.size() && filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0;
+  };
+  if(ends(".csv")) return std::unique_ptr<sink>(new textwriter(filename, columns));
+  if(ends(".jsonl")) return std::unique_ptr<sink>(new textwriter(filename, columns, true));
+  return std::unique_ptr<sink>(new columnwriter(filename, columns, 65536, compress));
+}
+
+columnreader::columnreader(const std::string& filename) : m_data(nullptr), m_size(0), m_good(false), m_records(0) {
+
+  int fd = open(filename.c_str(), O_RDONLY);
+  struct stat info;
+  if(fd < 0 || fstat(fd, &info) != 0 || info.st_size < 16) {
+    LOG(logERROR) << "Cannot read columnar file " << filename;
+    if(fd >= 0) close(fd);
+    return;
+  }
+  m_size = info.st_size;
+  void* mapped = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(mapped == MAP_FAILED) {
+    LOG(logERROR) << "Cannot map columnar file " << filename;
+    return;
+  }
+  m_data = static_cast<const char*>(mapped);
+
+  // Index the chunks, rejecting truncated files:
+  size_t position = 0;
+  auto word = [this, &position](uint64_t& value) {
+    if(position + 8 > m_size) return false;
+    std::memcpy(&value, m_data + position, 8);
+    position += 8;
+    return true;
+  };
+  // Sizes are read from the file and compared with the remaining bytes to avoid overflows:
+  auto skip = [this, &position](uint64_t size) {
+    if(size > m_size - position || padded(size) > m_size - position) return false;
+    position += padded(size);
+    return true;
+  };
+
+  bool valid = (std::memcmp(m_data, column_magic, 8) == 0);
+  position = 8;
+  uint64_t columns = 0;
+  // Every column needs at least its name length:
+  valid = valid && word(columns) && columns <= (m_size - position)/8;
+  for(uint64_t c = 0; valid && c < columns; c++) {
+    uint64_t length = 0;
+    valid = word(length) && length <= m_size - position;
+    if(valid) m_columns.push_back(std::string(m_data + position, length));
+    valid = valid && skip(length);
+  }
+
+  while(valid && position < m_size) {
+    chunk ch;
+    uint64_t records = 0, compressed = 0;
+    valid = word(records) && word(compressed);
+    std::vector<uint64_t> sizes(columns);
+    for(auto& size : sizes) valid = valid && word(size);
+    if(!valid) break;
+    ch.records = records;
+    ch.compressed = (compressed != 0);
+    // Uncompressed columns hold the records, zlib compresses by at most a factor of 1032:
+    valid = valid && records <= m_size/sizeof(double)*(ch.compressed ? 1032 : 1);
+    for(auto size : sizes) {
+      if(!ch.compressed && size != records*sizeof(double)) valid = false;
+      ch.offsets.push_back(position);
+      ch.sizes.push_back(size);
+      valid = valid && skip(size);
+    }
+    if(!valid) break;
+    m_chunks.push_back(ch);
+    m_records += records;
+  }
+
+  if(!valid) {
+    LOG(logERROR) << "Columnar file " << filename << " is corrupt or truncated after " << m_records << " records.";
+  }
+#ifndef GBLSIM_ZLIB
+  for(const auto& ch : m_chunks) {
+    if(ch.compressed) {
+      LOG(logERROR) << "Columnar file " << filename << " is compressed, but zlib is not available.";
+      valid = false;
+      break;
+    }
+  }
+#endif
+  m_good = valid;
+  LOG(logDEBUG) << "Mapped " << m_records << " records in " << m_chunks.size() << " chunks from " << filename;
+}
+
+columnreader::~columnreader() {
+  if(m_data) munmap(const_cast<char*>(m_data), m_size);
+}
+
+int columnreader::getColumn(const std::string& name) const {
+  for(size_t c = 0; c < m_columns.size(); c++) {
+    if(m_columns[c] == name) return c;
+  }
+  return -1;
+}
+
+const double* columnreader::get(size_t chunk, size_t column, std::vector<double>& buffer) const {
+  if(chunk >= m_chunks.size() || column >= m_columns.size()) return nullptr;
+  const auto& ch = m_chunks[chunk];
+  const char* data = m_data + ch.offsets[column];
+  if(!ch.compressed) return reinterpret_cast<const double*>(data);
+
+#ifdef GBLSIM_ZLIB
+  buffer.resize(ch.records);
+  uLongf length = ch.records*sizeof(double);
+  if(uncompress(reinterpret_cast<Bytef*>(buffer.data()), &length, reinterpret_cast<const Bytef*>(data), ch.sizes[column]) != Z_OK
+     || length != ch.records*sizeof(double)) {
+    LOG(logERROR) << "Cannot decompress column " << m_columns[column] << " in chunk " << chunk;
+    return nullptr;
+  }
+  return buffer.data();
+#else
+  return nullptr;
+#endif
+}
+
+std::vector<double> columnreader::get(size_t column) const {
+  std::vector<double> values, buffer;
+  values.reserve(m_records);
+  for(size_t c = 0; c < m_chunks.size(); c++) {
+    const double* data = get(c, column, buffer);
+    if(!data) break;
+    values.insert(values.end(), data, data + m_chunks[c].records);
+  }
+  return values;
+}
+
+void columnreader::release(size_t chunk) const {
+  if(chunk >= m_chunks.size() || m_chunks[chunk].offsets.empty()) return;
+  const auto& ch = m_chunks[chunk];
+  // Only whole pages within the chunk, shared pages at its borders stay mapped:
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t begin = (ch.offsets.front() + page - 1)/page*page;
+  size_t end = (ch.offsets.back() + ch.sizes.back())/page*page;
+  if(end > begin) madvise(const_cast<char*>(m_data) + begin, end - begin, MADV_DONTNEED);
+}
@@ -0,0 +1,128 @@
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gblsim {
+
+  // Destination for result records, one value per column. Sinks are not thread-safe, records
+  // from several threads have to be collected first.
+  class sink {
+  public:
+    explicit sink(std::vector<std::string> columns) : m_columns(columns) {}
+    virtual ~sink() {}
+
+    const std::vector<std::string>& getColumns() const { return m_columns; }
+
+    // Append one record with a value for every column
+    virtual bool write(const std::vector<double>& record) = 0;
+    // Write all buffered records
+    virtual void flush() {}
+    // Whether the sink could be opened and all records have been written
+    virtual bool good() const = 0;
+
+  protected:
+    std::vector<std::string> m_columns;
+  };
+
+  // Binary columnar file.
+  //
+  // Records are collected in chunks and every chunk is stored column by column, so each column of
+  // a chunk is a contiguous array of doubles. With compression (requires zlib), every column of a
+  // chunk is deflated separately. Integers are uint64, all numbers are in host byte order and all
+  // sections are padded to multiples of 8 bytes:
+  //
+  //   "GBLCOL01", number of columns, per column the name length and name
+  //   per chunk: number of records, compression flag, per column the stored size, column data
+  class columnwriter : public sink {
+  public:
+    columnwriter(const std::string& filename, std::vector<std::string> columns,
+                 size_t chunk = 65536, bool compress = false);
+    ~columnwriter();
+
+    bool write(const std::vector<double>& record);
+    void flush();
+    bool good() const { return m_good; }
+
+  private:
+    void writeWords(const std::vector<uint64_t>& words);
+    void writePadded(const char* data, size_t size);
+
+    std::ofstream m_file;
+    size_t m_chunk;
+    bool m_compress;
+    bool m_good;
+    // Records of the current chunk, column by column:
+    std::vector<std::vector<double>> m_buffer;
+  };
+
+  // Text file with comma-separated values and a header line, or JSON lines with one object per record
+  class textwriter : public sink {
+  public:
+    textwriter(const std::string& filename, std::vector<std::string> columns, bool json = false);
+
+    bool write(const std::vector<double>& record);
+    void flush() { m_file.flush(); }
+    bool good() const { return m_good; }
+
+  private:
+    std::ofstream m_file;
+    bool m_json;
+    bool m_good;
+  };
+
+  // Sink selected by the file extension: .csv and .jsonl for text, columnar otherwise
+  std::unique_ptr<sink> openSink(const std::string& filename, std::vector<std::string> columns,
+                                 bool compress = false);
+
+  // Memory-mapped readback of a columnar file. Uncompressed columns are read directly from the
+  // mapped file without copying.
+  class columnreader {
+  public:
+    explicit columnreader(const std::string& filename);
+    ~columnreader();
+    // The mapping is released by the destructor:
+    columnreader(const columnreader&) = delete;
+    columnreader& operator=(const columnreader&) = delete;
+
+    // False for unreadable, corrupt or truncated files
+    bool good() const { return m_good; }
+    const std::vector<std::string>& getColumns() const { return m_columns; }
+    // Index of the named column, -1 if it does not exist
+    int getColumn(const std::string& name) const;
+    size_t getRecords() const { return m_records; }
+    size_t getChunks() const { return m_chunks.size(); }
+    size_t getRecords(size_t chunk) const { return m_chunks.at(chunk).records; }
+
+    // Values of one column in one chunk. Points into the mapped file for uncompressed chunks,
+    // otherwise into the given buffer. Returns nullptr for invalid chunks.
+    const double* get(size_t chunk, size_t column, std::vector<double>& buffer) const;
+    // All values of one column
+    std::vector<double> get(size_t column) const;
+    // Drop the mapped pages of a processed chunk from memory, they are read again when accessed.
+    // Keeps the resident memory bounded when streaming through files larger than the RAM.
+    void release(size_t chunk) const;
+
+  private:
+    struct chunk {
+      size_t records;
+      bool compressed;
+      std::vector<size_t> offsets;
+      std::vector<size_t> sizes;
+    };
+
+    const char* m_data;
+    size_t m_size;
+    bool m_good;
+    std::vector<std::string> m_columns;
+    std::vector<chunk> m_chunks;
+    size_t m_records;
+  };
+
+}
+
+#endif /* RESULTS_H */
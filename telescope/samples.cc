@@ -0,0 +1,148 @@
+// Evaluation of geometry samples from columnar files
+
+#include "samples.h"
+#include "threadpool.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace gblsim;
+using namespace unilog;
+
+sampleevaluator::sampleevaluator(std::vector<plane> nominal, double beam_energy, size_t target, double material) :
+  m_nominal(nominal),
+  m_beamEnergy(beam_energy),
+  m_target(target),
+  m_material(material)
+{}
+
+std::vector<std::string> sampleevaluator::getColumns() const {
+  std::vector<std::string> columns = {"resolution_x", "resolution_y"};
+  if(m_target < m_nominal.size() && m_nominal[m_target].isUnknown()) {
+    columns.push_back("kink_x");
+    columns.push_back("kink_y");
+  }
+  return columns;
+}
+
+bool sampleevaluator::getReplacements(const columnreader& samples, std::vector<replacement>& replacements, int& beam) const {
+  beam = -1;
+  const std::vector<std::pair<std::string, parameter>> prefixes = {
+    {"resolutiony", resolution_y}, {"resolution", resolution}, {"material", material}, {"z", position}};
+
+  for(size_t c = 0; c < samples.getColumns().size(); c++) {
+    const std::string& name = samples.getColumns()[c];
+    if(name == "beam") {
+      beam = c;
+      continue;
+    }
+    bool known = false;
+    for(const auto& prefix : prefixes) {
+      if(name.compare(0, prefix.first.size(), prefix.first) != 0 || name.size() == prefix.first.size()) continue;
+      std::string index = name.substr(prefix.first.size());
+      if(index.find_first_not_of("0123456789") != std::string::npos) continue;
+      size_t p = std::stoul(index);
+      if(p >= m_nominal.size()) {
+        LOG(logERROR) << "Sample column " << name << " refers to plane " << p << ", but there are only " << m_nominal.size();
+        return false;
+      }
+      if((prefix.second == resolution || prefix.second == resolution_y) && !m_nominal[p].measurement()) {
+        LOG(logERROR) << "Sample column " << name << " sets the resolution of a plane without measurement";
+        return false;
+      }
+      replacements.push_back(replacement{c, p, prefix.second});
+      known = true;
+      break;
+    }
+    if(!known) {
+      LOG(logWARNING) << "Ignoring sample column " << name;
+    }
+  }
+
+  // Resolutions in y are applied after those in both dimensions:
+  std::stable_sort(replacements.begin(), replacements.end(),
+                   [](const replacement& a, const replacement& b) { return a.type < b.type; });
+  return true;
+}
+
+bool sampleevaluator::evaluate(const columnreader& samples, sink& output) const {
+  if(!samples.good() || m_target >= m_nominal.size()) {
+    LOG(logERROR) << "No samples or invalid target plane";
+    return false;
+  }
+  std::vector<replacement> replacements;
+  int beam;
+  if(!getReplacements(samples, replacements, beam)) return false;
+  LOG(logINFO) << "Evaluating " << samples.getRecords() << " samples with " << replacements.size()
+               << " plane parameters" << (beam >= 0 ? " and the beam energy" : "");
+
+  const bool kink = m_nominal[m_target].isUnknown();
+  const size_t width = (kink ? 4 : 2);
+  std::vector<std::vector<double>> buffers(samples.getColumns().size());
+  std::vector<const double*> columns(samples.getColumns().size(), nullptr);
+  std::vector<double> results;
+  std::vector<double> record(width);
+
+  for(size_t chunk = 0; chunk < samples.getChunks(); chunk++) {
+    // Pointers into the mapped file, or decompressed buffers:
+    for(size_t c = 0; c < columns.size(); c++) {
+      columns[c] = samples.get(chunk, c, buffers[c]);
+      if(!columns[c]) return false;
+    }
+
+    const size_t records = samples.getRecords(chunk);
+    results.resize(records*width);
+    threadpool::global().parallel_for(records, [&](size_t r) {
+        std::vector<plane> planes = m_nominal;
+        // Records with values outside their range are not evaluated:
+        bool valid = true;
+        for(const auto& rep : replacements) {
+          plane& pl = planes[rep.plane];
+          double value = columns[rep.column][r];
+          valid &= std::isfinite(value) && (rep.type == position || (rep.type == material ? value >= 0. : value > 0.));
+          switch(rep.type) {
+          case position: pl.setPosition(value); break;
+          case material: pl.setMaterial(value); break;
+          case resolution: pl = plane::active(pl.position(), pl.material(), value); break;
+          case resolution_y:
+            pl = plane::active(pl.position(), pl.material(), std::make_pair(pl.resolution().first, value));
+            break;
+          }
+        }
+        double energy = (beam >= 0 ? columns[beam][r] : m_beamEnergy);
+
+        // Index of the target among the planes ordered in z:
+        double z = planes[m_target].position();
+        int index = 0;
+        for(size_t p = 0; p < planes.size(); p++) {
+          if(planes[p].position() < z || (planes[p].position() == z && p < m_target)) index++;
+        }
+
+        double* result = &results[r*width];
+        if(!valid || !std::isfinite(energy) || !(energy > 0.)) {
+          std::fill(result, result + width, std::numeric_limits<double>::quiet_NaN());
+          return;
+        }
+        telescope tel(planes, energy, m_material);
+        std::pair<double,double> res = tel.getResolutionXY(index);
+        result[0] = res.first;
+        result[1] = res.second;
+        if(kink) {
+          std::pair<double,double> k = tel.getKinkResolutionXY(index);
+          result[2] = k.first;
+          result[3] = k.second;
+        }
+      });
+
+    for(size_t r = 0; r < records; r++) {
+      record.assign(results.begin() + r*width, results.begin() + (r+1)*width);
+      if(!output.write(record)) return false;
+    }
+    samples.release(chunk);
+    LOG(logDEBUG) << "Evaluated chunk " << chunk << " with " << records << " samples";
+  }
+  output.flush();
+  return output.good();
+}
@@ -0,0 +1,58 @@
+#ifndef SAMPLES_H
+#define SAMPLES_H
+
+#include <string>
+#include <vector>
+
+#include "assembly.h"
+#include "results.h"
+
+namespace gblsim {
+
+  // Evaluation of externally generated geometry samples, e.g. from alignment fits.
+  //
+  // Samples are records of a columnar file (see columnwriter), one geometry per record. Columns
+  // replace parameters of the nominal planes, addressed by their index p in the nominal list:
+  //
+  //   z<p>             position in [mm]
+  //   material<p>      material budget x/X0
+  //   resolution<p>    resolution of a measurement plane in [mm], in both dimensions
+  //   resolutiony<p>   resolution in y, if different
+  //   beam             beam energy in [GeV]
+  //
+  // All other parameters keep their nominal values. The file is mapped and read chunk by chunk
+  // without copying uncompressed columns, the records of each chunk are evaluated in parallel
+  // and their results are written in sample order, one record per sample: the track resolution
+  // at the target plane, resolution_x and resolution_y in [um], and for unknown scatterers the
+  // kink resolution, kink_x and kink_y in [urad]. Samples with non-finite values, negative
+  // material, or non-positive resolutions or beam energy give NaN. Processed chunks are
+  // released, so files much larger than the memory are evaluated with the memory of one chunk.
+  class sampleevaluator {
+  public:
+    sampleevaluator(std::vector<plane> nominal, double beam_energy, size_t target, double material = X0_Air);
+
+    // Columns written for every sample
+    std::vector<std::string> getColumns() const;
+
+    // Evaluate all samples, returns false for unusable columns or failed output
+    bool evaluate(const columnreader& samples, sink& output) const;
+
+  private:
+    // Parameter of one plane replaced by a sample column
+    enum parameter { position, material, resolution, resolution_y };
+    struct replacement {
+      size_t column;
+      size_t plane;
+      parameter type;
+    };
+    bool getReplacements(const columnreader& samples, std::vector<replacement>& replacements, int& beam) const;
+
+    std::vector<plane> m_nominal;
+    double m_beamEnergy;
+    size_t m_target;
+    double m_material;
+  };
+
+}
+
+#endif /* SAMPLES_H */
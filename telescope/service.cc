@@ -0,0 +1,340 @@
+// Line-delimited JSON query service
+
+#include "service.h"
+#include "log.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace gblsim;
+using namespace unilog;
+
+namespace {
+  bool isFinite(const json& value) {
+    return value.isNumber() && std::isfinite(value.number());
+  }
+
+  // Geometry of a request, returns false with a message for invalid input
+  bool getGeometry(const json& request, std::vector<plane>& planes, double& beam_energy, double& material, std::string& error) {
+    if(!isFinite(request["beam"]) || request["beam"].number() <= 0.) {
+      error = "missing or invalid beam energy";
+      return false;
+    }
+    beam_energy = request["beam"].number();
+    if(request["volume"].isNumber() && !isFinite(request["volume"])) {
+      error = "invalid volume material";
+      return false;
+    }
+    material = (request["volume"].isNumber() ? request["volume"].number() : X0_Air);
+
+    if(!request["planes"].isArray() || request["planes"].array().empty()) {
+      error = "missing planes";
+      return false;
+    }
+    for(const auto& p : request["planes"].array()) {
+      if(!isFinite(p["z"])) {
+        error = "plane without valid position z";
+        return false;
+      }
+      double z = p["z"].number();
+      if(!p["material"].isNull() && (!isFinite(p["material"]) || p["material"].number() < 0.)) {
+        error = "invalid plane material";
+        return false;
+      }
+      double x0 = (p["material"].isNumber() ? p["material"].number() : 0.);
+      const json& res = p["resolution"];
+      // Resolutions of zero would be measurements with infinite precision:
+      bool positive = (isFinite(res) && res.number() > 0.);
+      if(res.isArray() && res.array().size() == 2) {
+        positive = isFinite(res.array()[0]) && res.array()[0].number() > 0.
+          && isFinite(res.array()[1]) && res.array()[1].number() > 0.;
+      }
+      if(!res.isNull() && !positive) {
+        error = "invalid plane resolution";
+        return false;
+      }
+      if(!p["unknown"].isNull() && (!isFinite(p["unknown"]) || p["unknown"].number() < 0.)) {
+        error = "invalid size of unknown scatterer";
+        return false;
+      }
+
+      if(res.isNumber()) planes.push_back(plane::active(z, x0, res.number()));
+      else if(res.isArray()) {
+        planes.push_back(plane::active(z, x0, std::make_pair(res.array()[0].number(), res.array()[1].number())));
+      }
+      else if(p["unknown"].isNumber()) planes.push_back(plane::unknown(z, p["unknown"].number()));
+      else if(p["reference"].boolean() || x0 <= 0.) planes.push_back(plane::reference(z));
+      else planes.push_back(plane::inactive(z, x0));
+    }
+    std::stable_sort(planes.begin(), planes.end());
+    return true;
+  }
+
+  json pair(const std::pair<double,double>& values) {
+    return json(std::vector<json>{json(values.first), json(values.second)});
+  }
+
+  // Index of the queried plane, adding a reference plane at "z" if needed
+  bool getPlane(const json& request, std::vector<plane>& planes, size_t& index, std::string& error) {
+    if(request["z"].isNumber()) {
+      if(!isFinite(request["z"])) {
+        error = "invalid position z";
+        return false;
+      }
+      double z = request["z"].number();
+      for(size_t p = 0; p < planes.size(); p++) {
+        if(planes[p].position() == z) {
+          index = p;
+          return true;
+        }
+      }
+      planes.push_back(plane::reference(z));
+      std::stable_sort(planes.begin(), planes.end());
+      for(index = 0; planes[index].position() != z; index++) {}
+      return true;
+    }
+    if(!isFinite(request["plane"]) || request["plane"].number() < 0 || request["plane"].number() >= planes.size()) {
+      error = "missing or invalid plane";
+      return false;
+    }
+    index = static_cast<size_t>(request["plane"].number());
+    return true;
+  }
+}
+
+service::service(size_t capacity, resultcache* disk) :
+  m_capacity(std::max<size_t>(capacity, 1)),
+  m_disk(disk),
+  m_mutex(),
+  m_order(),
+  m_entries(),
+  m_hits(0),
+  m_misses(0),
+  m_requests(0),
+  m_latency()
+{}
+
+service::entry service::evaluate(const std::vector<plane>& planes, double beam_energy, double material) {
+  std::string key = resultcache::describe(planes, beam_energy, material, "gbl");
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    if(it != m_entries.end()) {
+      // Move to the front of the LRU order:
+      m_order.splice(m_order.begin(), m_order, it->second.second);
+      m_hits++;
+      return it->second.first;
+    }
+    m_misses++;
+  }
+
+  // Fit outside of the lock, concurrent requests for the same geometry may both fit:
+  entry results = std::make_shared<const std::vector<planeresult>>(
+    m_disk ? m_disk->evaluate(planes, beam_energy, material) : fitPlanes(planes, beam_energy, material));
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if(m_entries.count(key) == 0) {
+    m_order.push_front(key);
+    m_entries[key] = std::make_pair(results, m_order.begin());
+    if(m_entries.size() > m_capacity) {
+      m_entries.erase(m_order.back());
+      m_order.pop_back();
+    }
+  }
+  return results;
+}
+
+json service::answer(const json& request) {
+  json response = json::object();
+  if(request.has("id")) response.set("id", request["id"]);
+  const std::string query = request["query"].string();
+  std::string error;
+
+  if(query == "statistics") {
+    json stats = json::object();
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      stats.set("requests", m_requests).set("hits", m_hits).set("misses", m_misses).set("cached", m_entries.size());
+    }
+    stats.set("latency_p50", getLatency(0.5)).set("latency_p90", getLatency(0.9))
+      .set("latency_p99", getLatency(0.99)).set("latency_max", getLatency(1.));
+    return response.set("result", stats);
+  }
+
+  std::vector<plane> planes;
+  double beam_energy, material;
+  if(!getGeometry(request, planes, beam_energy, material, error)) return response.set("error", error);
+
+  if(query == "residuals") {
+    entry results = evaluate(planes, beam_energy, material);
+    std::vector<json> widths;
+    for(size_t p = 0; p < results->size(); p++) {
+      if(!planes[p].measurement()) continue;
+      widths.push_back(json::object().set("plane", p).set("biased", pair(results->at(p).biased))
+                       .set("unbiased", pair(results->at(p).unbiased)));
+    }
+    return response.set("result", json(widths));
+  }
+
+  size_t index;
+  if(!getPlane(request, planes, index, error)) return response.set("error", error);
+
+  if(query == "resolution") return response.set("result", pair(evaluate(planes, beam_energy, material)->at(index).resolution));
+  if(query == "kink") {
+    if(!planes[index].isUnknown()) return response.set("error", "plane is not an unknown scatterer");
+    return response.set("result", pair(evaluate(planes, beam_energy, material)->at(index).kink));
+  }
+
+  if(query == "scan") {
+    const std::string parameter = request["parameter"].string();
+    if(!request["values"].isArray() || (parameter != "beam" && parameter != "position")) {
+      return response.set("error", "scan needs values and the parameter beam or position");
+    }
+    // The scanned plane is given by its index in z order, including an added query plane:
+    size_t moving = 0;
+    if(parameter == "position") {
+      double z = (isFinite(request["scan_plane"]) ? request["scan_plane"].number() : -1);
+      if(z < 0 || z >= planes.size()) return response.set("error", "missing or invalid scan_plane");
+      moving = static_cast<size_t>(z);
+    }
+
+    const auto& values = request["values"].array();
+    for(const auto& value : values) {
+      if(!isFinite(value) || (parameter == "beam" && value.number() <= 0.)) {
+        return response.set("error", "invalid scan value, expected " + std::string(parameter == "beam" ? "positive beam energies" : "positions"));
+      }
+    }
+    std::vector<json> results(values.size());
+    threadpool::global().parallel_for(values.size(), [&](size_t v) {
+        std::vector<plane> variant = planes;
+        double energy = beam_energy;
+        if(parameter == "beam") energy = values[v].number();
+        else variant[moving].setPosition(values[v].number());
+        // Follow the queried plane through the reordering:
+        std::vector<size_t> order(variant.size());
+        for(size_t p = 0; p < order.size(); p++) order[p] = p;
+        std::stable_sort(order.begin(), order.end(), [&variant](size_t a, size_t b) { return variant[a] < variant[b]; });
+        size_t position = std::find(order.begin(), order.end(), index) - order.begin();
+        results[v] = pair(evaluate(variant, energy, material)->at(position).resolution);
+      });
+    return response.set("result", json(results));
+  }
+
+  return response.set("error", "unknown query '" + query + "'");
+}
+
+std::string service::handle(const std::string& request) {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  json parsed, response;
+  std::string error;
+  if(!json::parse(request, parsed, error) || !parsed.isObject()) {
+    response = json::object().set("error", "invalid request: " + (error.empty() ? std::string("not an object") : error));
+  }
+  else response = answer(parsed);
+
+  double latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_requests++;
+    m_latency.fill(latency);
+  }
+  return response.dump();
+}
+
+double service::getLatency(double quantile) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_latency.quantile(quantile);
+}
+
+void service::serve(int input, int output) {
+  // Requests in flight, the connection is only closed once all have been answered. Reading stops
+  // while the limit is reached, so a client sending faster than it is answered is slowed down:
+  std::mutex mutex;
+  std::condition_variable answered;
+  size_t pending = 0;
+  const size_t limit = 4*std::max<size_t>(threadpool::global().size(), 1);
+
+  auto respond = [output, &mutex](const std::string& line) {
+    std::string out = line + "\n";
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t written = 0;
+    while(written < out.size()) {
+      ssize_t n = ::write(output, out.data() + written, out.size() - written);
+      if(n <= 0) return;
+      written += n;
+    }
+  };
+
+  std::string buffer;
+  char chunk[65536];
+  while(true) {
+    ssize_t n = ::read(input, chunk, sizeof(chunk));
+    if(n <= 0) break;
+    buffer.append(chunk, n);
+    size_t start = 0, end;
+    while((end = buffer.find('\n', start)) != std::string::npos) {
+      std::string line = buffer.substr(start, end - start);
+      start = end + 1;
+      if(line.find_first_not_of(" \t\r") == std::string::npos) continue;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        answered.wait(lock, [&pending, limit]() { return pending < limit; });
+        pending++;
+      }
+      threadpool::global().submit([this, line, &respond, &mutex, &answered, &pending]() {
+          respond(handle(line));
+          std::lock_guard<std::mutex> lock(mutex);
+          pending--;
+          answered.notify_all();
+        });
+    }
+    buffer.erase(0, start);
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  answered.wait(lock, [&pending]() { return pending == 0; });
+}
+
+bool service::listen(const std::string& path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if(fd < 0 || path.size() >= sizeof(address.sun_path)) {
+    LOG(logERROR) << "Cannot create socket " << path;
+    if(fd >= 0) close(fd);
+    return false;
+  }
+  std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  unlink(path.c_str());
+  if(bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, 16) != 0) {
+    LOG(logERROR) << "Cannot listen on " << path << ": " << std::strerror(errno);
+    close(fd);
+    return false;
+  }
+  LOG(logINFO) << "Listening on " << path;
+
+  while(true) {
+    int connection = accept(fd, nullptr, nullptr);
+    if(connection < 0) {
+      if(errno == EINTR) continue;
+      LOG(logERROR) << "Accepting connection failed: " << std::strerror(errno);
+      break;
+    }
+    std::thread([this, connection]() {
+        serve(connection, connection);
+        close(connection);
+      }).detach();
+  }
+  close(fd);
+  return false;
+}
@@ -0,0 +1,76 @@
+#ifndef SERVICE_H
+#define SERVICE_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cache.h"
+#include "json.h"
+#include "statistics.h"
+
+namespace gblsim {
+
+  // Query service answering line-delimited JSON requests from warm fit caches.
+  //
+  // Every request is one JSON object on one line with the geometry and the query:
+  //
+  //   {"id": 1, "beam": 5.0, "volume": 304200,
+  //    "planes": [{"z": 0, "material": 6.5e-4, "resolution": 3.24e-3}, {"z": 20, "material": 0.01},
+  //               {"z": 40, "unknown": 0.5}, {"z": 60, "reference": true}, ...],
+  //    "query": "resolution", "plane": 1}
+  //
+  // Planes with a resolution (number or [x, y]) are active, planes with "unknown" are unknown
+  // scatterers of the given size, and all others are inactive, or reference planes without
+  // material. Queries:
+  //
+  //   resolution, kink   at "plane" (index in z order) or at "z" (a reference plane is added)
+  //   residuals          biased and unbiased widths of all measurement planes
+  //   scan               resolution at "plane" or "z" for all "values" of the "parameter" beam or
+  //                      position of plane "scan_plane"
+  //   statistics         number of requests, latency percentiles and cache counters
+  //
+  // Results of all planes of a geometry are fitted together and kept in an in-memory LRU cache,
+  // optionally backed by the persistent cache. Responses carry the request id and either "result"
+  // or "error", and may be out of order since requests are handled concurrently.
+  class service {
+  public:
+    explicit service(size_t capacity = 4096, resultcache* disk = nullptr);
+
+    // Answer one request line, thread-safe
+    std::string handle(const std::string& request);
+
+    // Answer all requests read from the input descriptor on the output descriptor until the input
+    // ends, handling them concurrently on the global thread pool
+    void serve(int input, int output);
+    // Accept connections on a Unix domain socket and serve each of them, returns only on errors
+    bool listen(const std::string& path);
+
+    // Latency percentile in [ms] over all requests so far
+    double getLatency(double quantile);
+
+  private:
+    typedef std::shared_ptr<const std::vector<planeresult>> entry;
+
+    // Results of all planes, from the caches or fitted
+    entry evaluate(const std::vector<plane>& planes, double beam_energy, double material);
+    json answer(const json& request);
+
+    size_t m_capacity;
+    resultcache* m_disk;
+
+    std::mutex m_mutex;
+    std::list<std::string> m_order;
+    std::unordered_map<std::string, std::pair<entry, std::list<std::string>::iterator>> m_entries;
+    size_t m_hits;
+    size_t m_misses;
+    size_t m_requests;
+    tdigest m_latency;
+  };
+
+}
+
+#endif /* SERVICE_H */
@@ -0,0 +1,181 @@
+// Sharded studies with checkpoints
+
+#include "shards.h"
+#include "log.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <unistd.h>
+
+using namespace gblsim;
+using namespace unilog;
+
+namespace {
+  // File identifier and format version:
+  const char checkpoint_magic[] = "GBLCKP01";
+}
+
+bool shard::parse(const std::string& text, shard& part) {
+  size_t slash = text.find('/');
+  if(slash == std::string::npos || slash == 0 || slash + 1 == text.size()
+     || text.find_first_not_of("0123456789/") != std::string::npos) {
+    return false;
+  }
+  size_t index = std::stoul(text.substr(0, slash));
+  size_t count = std::stoul(text.substr(slash + 1));
+  if(count == 0 || index >= count) return false;
+  part = shard(index, count);
+  return true;
+}
+
+checkpoint::checkpoint(const std::string& study, size_t items, const std::string& filename, double interval) :
+  m_study(study),
+  m_items(items),
+  m_filename(filename),
+  m_interval(interval),
+  m_saved(std::chrono::steady_clock::now()),
+  m_mutex(),
+  m_states()
+{}
+
+bool checkpoint::load() {
+  if(m_filename.empty()) return true;
+  std::ifstream in(m_filename.c_str(), std::ios::binary | std::ios::ate);
+  if(!in) return true;
+
+  // Sizes read from the file are checked against the remaining bytes before allocating:
+  const std::streamoff filesize = in.tellg();
+  in.seekg(0);
+  auto remaining = [&in, filesize]() { return static_cast<uint64_t>(filesize - in.tellg()); };
+
+  char magic[8];
+  uint64_t length = 0, items = 0, count = 0;
+  bool valid = in.read(magic, 8) && std::memcmp(magic, checkpoint_magic, 8) == 0
+    && in.read(reinterpret_cast<char*>(&length), sizeof(length)) && length <= remaining();
+  std::string study(valid ? length : 0, '\0');
+  valid = valid && in.read(&study[0], length) && in.read(reinterpret_cast<char*>(&items), sizeof(items))
+    && in.read(reinterpret_cast<char*>(&count), sizeof(count));
+  if(!valid) {
+    LOG(logERROR) << "Checkpoint " << m_filename << " is unreadable";
+    return false;
+  }
+  if(study != m_study || items != m_items) {
+    LOG(logERROR) << "Checkpoint " << m_filename << " belongs to a different study";
+    return false;
+  }
+
+  std::map<size_t, std::vector<double>> states;
+  for(uint64_t i = 0; valid && i < count; i++) {
+    uint64_t item = 0, size = 0;
+    valid = in.read(reinterpret_cast<char*>(&item), sizeof(item)) && in.read(reinterpret_cast<char*>(&size), sizeof(size))
+      && item < m_items && size <= remaining()/sizeof(double);
+    if(!valid) break;
+    std::vector<double> state(size);
+    valid = static_cast<bool>(in.read(reinterpret_cast<char*>(state.data()), size*sizeof(double)));
+    states[item].swap(state);
+  }
+  if(!valid) {
+    LOG(logERROR) << "Checkpoint " << m_filename << " is truncated";
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_states.swap(states);
+  LOG(logINFO) << "Loaded " << m_states.size() << " of " << m_items << " items from checkpoint " << m_filename;
+  return true;
+}
+
+bool checkpoint::save() {
+  if(m_filename.empty()) return true;
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  std::ostringstream temporary;
+  temporary << m_filename << ".tmp." << getpid();
+  {
+    std::ofstream out(temporary.str().c_str(), std::ios::binary);
+    uint64_t length = m_study.size(), items = m_items, count = m_states.size();
+    out.write(checkpoint_magic, 8);
+    out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    out.write(m_study.data(), length);
+    out.write(reinterpret_cast<const char*>(&items), sizeof(items));
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for(const auto& s : m_states) {
+      uint64_t item = s.first, size = s.second.size();
+      out.write(reinterpret_cast<const char*>(&item), sizeof(item));
+      out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+      out.write(reinterpret_cast<const char*>(s.second.data()), size*sizeof(double));
+    }
+    out.flush();
+    if(!out) {
+      LOG(logERROR) << "Cannot write checkpoint " << temporary.str();
+      std::remove(temporary.str().c_str());
+      return false;
+    }
+  }
+  if(std::rename(temporary.str().c_str(), m_filename.c_str()) != 0) {
+    LOG(logERROR) << "Cannot replace checkpoint " << m_filename;
+    std::remove(temporary.str().c_str());
+    return false;
+  }
+  m_saved = std::chrono::steady_clock::now();
+  LOG(logDEBUG) << "Saved " << m_states.size() << " of " << m_items << " items to " << m_filename;
+  return true;
+}
+
+bool checkpoint::add(const checkpoint& other) {
+  if(other.m_study != m_study || other.m_items != m_items) {
+    LOG(logERROR) << "Cannot merge checkpoints of different studies";
+    return false;
+  }
+  std::lock(m_mutex, other.m_mutex);
+  std::lock_guard<std::mutex> lock(m_mutex, std::adopt_lock);
+  std::lock_guard<std::mutex> other_lock(other.m_mutex, std::adopt_lock);
+  for(const auto& s : other.m_states) {
+    auto it = m_states.find(s.first);
+    // Items present twice, e.g. from overlapping shards, have to agree:
+    if(it != m_states.end() && it->second != s.second) {
+      LOG(logERROR) << "Item " << s.first << " differs between checkpoints";
+      return false;
+    }
+    m_states[s.first] = s.second;
+  }
+  return true;
+}
+
+size_t checkpoint::getCompleted() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_states.size();
+}
+
+bool checkpoint::has(size_t item) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_states.count(item) > 0;
+}
+
+bool checkpoint::complete(size_t begin, size_t end) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for(size_t item = begin; item < end; item++) {
+    if(m_states.count(item) == 0) return false;
+  }
+  return true;
+}
+
+std::vector<double> checkpoint::get(size_t item) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_states.find(item);
+  return (it == m_states.end() ? std::vector<double>() : it->second);
+}
+
+bool checkpoint::put(size_t item, const std::vector<double>& state) {
+  bool due;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(item >= m_items) return false;
+    m_states[item] = state;
+    due = (std::chrono::steady_clock::now() - m_saved >= m_interval);
+  }
+  return (due ? save() : true);
+}
@@ -0,0 +1,72 @@
+#ifndef SHARDS_H
+#define SHARDS_H
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace gblsim {
+
+  // One of several parts of a study split into independent items, e.g. blocks of tracks or rows
+  // of a scan grid. Shard i of n covers the items [i*items/n, (i+1)*items/n).
+  struct shard {
+    shard(size_t index = 0, size_t count = 1) : index(index), count(count) {}
+    size_t index;
+    size_t count;
+
+    size_t begin(size_t items) const { return items*index/count; }
+    size_t end(size_t items) const { return items*(index + 1)/count; }
+
+    // Parse "i/n", returns false for invalid shards
+    static bool parse(const std::string& text, shard& part);
+  };
+
+  // Partial results of the items of a study, stored in a file to resume after interruptions and
+  // to merge shards.
+  //
+  // Every item holds an exact state as numbers. The study description, e.g. all parameters and
+  // the seed, and the number of items are stored with the states, and only checkpoints of the
+  // same study can be resumed and merged. Files are written under a temporary name and renamed,
+  // so an interruption while saving leaves the previous checkpoint intact. Without file name, the
+  // checkpoint is kept in memory only.
+  class checkpoint {
+  public:
+    checkpoint(const std::string& study, size_t items, const std::string& filename = "", double interval = 60.);
+
+    // Read the file if it exists, returns false if it is unreadable or of a different study
+    bool load();
+    // Write all states to the file
+    bool save();
+
+    // Add the states of another checkpoint of the same study, returns false on mismatches
+    bool add(const checkpoint& other);
+
+    size_t getItems() const { return m_items; }
+    size_t getCompleted() const;
+    bool has(size_t item) const;
+    // Whether all items in [begin, end) are present
+    bool complete(size_t begin, size_t end) const;
+    bool complete() const { return complete(0, m_items); }
+
+    // State of a completed item, empty if missing
+    std::vector<double> get(size_t item) const;
+    // Store the state of an item, thread-safe. The file is saved when the interval has passed
+    // since the last save.
+    bool put(size_t item, const std::vector<double>& state);
+
+  private:
+    std::string m_study;
+    size_t m_items;
+    std::string m_filename;
+    std::chrono::duration<double> m_interval;
+    std::chrono::steady_clock::time_point m_saved;
+
+    mutable std::mutex m_mutex;
+    std::map<size_t, std::vector<double>> m_states;
+  };
+
+}
+
+#endif /* SHARDS_H */
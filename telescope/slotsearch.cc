@@ -0,0 +1,324 @@
+// Discrete search over slot assignments
+
+#include "slotsearch.h"
+#include "estimate.h"
+#include "log.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+using namespace gblsim;
+using namespace unilog;
+
+namespace {
+  // Slot which has not been decided yet:
+  const int slot_open = -3;
+}
+
+// Partial assignment, slots are decided in the given order
+struct slotsearch::node {
+  std::vector<int> slots;
+  std::vector<size_t> order;
+  size_t depth;
+  std::vector<unsigned int> used;
+  unsigned int planes;
+};
+
+// The k best complete assignments found so far, shared between threads
+class slotsearch::ranking {
+public:
+  explicit ranking(size_t k) : evaluated(0), pruned(0), saved(0), m_k(k) {}
+
+  // Resolution a subtree has to beat to enter the ranking
+  double threshold() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return (m_best.size() < m_k ? std::numeric_limits<double>::infinity() : m_best.back().first);
+  }
+
+  void insert(const std::vector<int>& slots, double resolution) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_best.size() == m_k && !(resolution < m_best.back().first)) return;
+    auto entry = std::make_pair(resolution, slots);
+    m_best.insert(std::upper_bound(m_best.begin(), m_best.end(), entry,
+                                   [](const entry_type& a, const entry_type& b) { return a.first < b.first; }), entry);
+    if(m_best.size() > m_k) m_best.pop_back();
+  }
+
+  typedef std::pair<double, std::vector<int>> entry_type;
+  const std::vector<entry_type>& get() const { return m_best; }
+
+  std::atomic<size_t> evaluated;
+  std::atomic<size_t> pruned;
+  // Fits avoided by the closed-form bound
+  std::atomic<size_t> saved;
+
+private:
+  size_t m_k;
+  std::vector<entry_type> m_best;
+  std::mutex m_mutex;
+};
+
+slotsearch::slotsearch(std::vector<double> slots, std::vector<device> devices, double dut_material,
+                       double beam_energy, double material) :
+  m_slots(slots),
+  m_devices(devices),
+  m_dutMaterial(dut_material),
+  m_beamEnergy(beam_energy),
+  m_volumeMaterial(material),
+  m_minPlanes(2),
+  m_maxPlanes(slots.size()),
+  m_dutSlots()
+{
+  for(size_t s = 0; s < m_slots.size(); s++) m_dutSlots.push_back(s);
+}
+
+void slotsearch::setPlanes(unsigned int min, unsigned int max) {
+  if(min < 2) {
+    LOG(logWARNING) << "Tracks need at least two sensor planes, raising the minimum from " << min;
+  }
+  m_minPlanes = std::max(min, 2u);
+  m_maxPlanes = max;
+}
+
+std::vector<layer<double>> slotsearch::getLayers(const std::vector<int>& slots, size_t& dut, double& total) const {
+
+  // Best resolution of any device type which can still be mounted:
+  double ideal = std::numeric_limits<double>::infinity();
+  for(const auto& dev : m_devices) {
+    if(dev.available > 0) ideal = std::min(ideal, dev.resolution);
+  }
+
+  std::vector<layer<double>> layers;
+  std::vector<unsigned int> used(m_devices.size(), 0);
+  unsigned int planes = 0;
+  bool open = false;
+  double zmin = std::numeric_limits<double>::infinity(), zmax = -zmin;
+  total = 0.;
+  dut = 0;
+  for(size_t s = 0; s < slots.size(); s++) {
+    if(slots.at(s) == slot_empty) continue;
+    if(slots.at(s) == slot_open) open = true;
+    else {
+      zmin = std::min(zmin, m_slots.at(s));
+      zmax = std::max(zmax, m_slots.at(s));
+    }
+    if(slots.at(s) >= 0) {
+      used.at(slots.at(s))++;
+      planes++;
+      total += m_devices.at(slots.at(s)).material;
+    }
+    layer<double> l;
+    l.position = m_slots.at(s);
+    if(slots.at(s) == slot_dut) {
+      l.material = m_dutMaterial;
+      dut = layers.size();
+    }
+    else {
+      l.measurement = true;
+      l.material = (slots.at(s) == slot_open ? 0. : m_devices.at(slots.at(s)).material);
+      l.resolution = (slots.at(s) == slot_open ? ideal : m_devices.at(slots.at(s)).resolution);
+    }
+    layers.push_back(l);
+  }
+
+  // Complete assignments use the material of their layers:
+  if(!open) {
+    total = 0.;
+    return layers;
+  }
+
+  // Smallest total material of any completion for the Highland factor: the DUT, the mounted
+  // sensors, the lightest sensors still needed for the minimum number of planes, and the volume
+  // between the decided planes. The ideal planes alone would underestimate it.
+  total += m_dutMaterial;
+  std::vector<double> lightest;
+  for(size_t d = 0; d < m_devices.size(); d++) {
+    for(unsigned int n = used.at(d); n < m_devices.at(d).available; n++) lightest.push_back(m_devices.at(d).material);
+  }
+  std::sort(lightest.begin(), lightest.end());
+  for(size_t n = 0; planes + n < m_minPlanes && n < lightest.size(); n++) total += lightest.at(n);
+  if(m_volumeMaterial > 0.) total += (zmax - zmin)/m_volumeMaterial;
+  // Keep the logarithm of the Highland formula defined without any material:
+  total = std::max(total, 1e-9);
+  return layers;
+}
+
+double slotsearch::bound(const std::vector<layer<double>>& layers, size_t dut, double total) const {
+
+  // Offset and slope of the track need two measurements:
+  if(std::count_if(layers.begin(), layers.end(), [](const layer<double>& l) { return l.measurement; }) < 2) {
+    return std::numeric_limits<double>::infinity();
+  }
+
+  trackmodel<double> model(layers, m_beamEnergy, m_volumeMaterial, total);
+  return std::sqrt(model.getVariance(dut))*1E3;
+}
+
+double slotsearch::evaluate(const std::vector<int>& slots) const {
+  if(slots.size() != m_slots.size() || std::count(slots.begin(), slots.end(), slot_dut) != 1) {
+    LOG(logERROR) << "Assignment needs one entry per slot and exactly one DUT.";
+    return std::numeric_limits<double>::infinity();
+  }
+  size_t dut;
+  double total;
+  std::vector<layer<double>> layers = getLayers(slots, dut, total);
+  return bound(layers, dut, total);
+}
+
+namespace {
+  template <typename N> std::vector<N> children(const N& parent, const std::vector<device>& devices,
+                                                unsigned int min_planes, unsigned int max_planes) {
+    std::vector<N> result;
+    size_t remaining = parent.order.size() - parent.depth;
+    if(remaining == 0) return result;
+
+    // All sensors mounted, remaining slots stay empty:
+    if(parent.planes >= max_planes) {
+      N child = parent;
+      for(size_t o = parent.depth; o < parent.order.size(); o++) child.slots.at(parent.order.at(o)) = slot_empty;
+      child.depth = parent.order.size();
+      if(child.planes >= min_planes) result.push_back(child);
+      return result;
+    }
+
+    size_t s = parent.order.at(parent.depth);
+    // Devices with the best resolution first to find good configurations early:
+    std::vector<size_t> types(devices.size());
+    for(size_t d = 0; d < types.size(); d++) types.at(d) = d;
+    std::sort(types.begin(), types.end(), [&devices](size_t a, size_t b) { return devices.at(a).resolution < devices.at(b).resolution; });
+    for(auto d : types) {
+      if(parent.used.at(d) >= devices.at(d).available) continue;
+      N child = parent;
+      child.slots.at(s) = d;
+      child.used.at(d)++;
+      child.planes++;
+      child.depth++;
+      result.push_back(child);
+    }
+
+    // Leave the slot empty if enough slots remain to reach the minimum number of planes:
+    if(parent.planes + remaining - 1 >= min_planes) {
+      N child = parent;
+      child.slots.at(s) = slot_empty;
+      child.depth++;
+      result.push_back(child);
+    }
+    return result;
+  }
+}
+
+void slotsearch::branch(node& current, ranking& best) const {
+
+  size_t dut;
+  double total;
+  std::vector<layer<double>> layers = getLayers(current.slots, dut, total);
+
+  // Closed-form lower bound first, the fit is only needed if it can enter the ranking:
+  double threshold = best.threshold();
+  if(!(estimateResolution(layers, dut, m_beamEnergy, m_volumeMaterial, total).lower < threshold)) {
+    best.pruned++;
+    best.saved++;
+    return;
+  }
+
+  double resolution = bound(layers, dut, total);
+  best.evaluated++;
+
+  // Complete assignment, without a track if it has too few measurements:
+  if(current.depth == current.order.size()) {
+    if(std::isfinite(resolution)) best.insert(current.slots, resolution);
+    return;
+  }
+
+  // No completion of this assignment can enter the ranking:
+  if(!(resolution < threshold)) {
+    best.pruned++;
+    return;
+  }
+
+  for(auto& child : children(current, m_devices, m_minPlanes, m_maxPlanes)) {
+    branch(child, best);
+  }
+}
+
+configuration slotsearch::getConfiguration(const std::vector<int>& slots, double resolution) const {
+  configuration config;
+  config.slots = slots;
+  config.resolution = resolution;
+  config.dut = 0;
+  double dut = m_slots.at(std::find(slots.begin(), slots.end(), slot_dut) - slots.begin());
+  for(size_t s = 0; s < slots.size(); s++) {
+    if(slots.at(s) == slot_empty || slots.at(s) == slot_dut) continue;
+    const device& dev = m_devices.at(slots.at(s));
+    config.planes.push_back(plane(m_slots.at(s), dev.material, true, dev.resolution));
+    if(m_slots.at(s) < dut) config.dut++;
+  }
+  config.planes.push_back(plane(dut, m_dutMaterial, false));
+  return config;
+}
+
+std::vector<configuration> slotsearch::search(unsigned int k) const {
+
+  std::vector<configuration> result;
+  if(m_slots.empty() || m_devices.empty() || k == 0) {
+    LOG(logERROR) << "Slot search needs slots and device types.";
+    return result;
+  }
+
+  // One root per DUT position, other slots are decided from the DUT outwards:
+  std::vector<node> frontier;
+  for(auto dut : m_dutSlots) {
+    if(dut < 0 || dut >= static_cast<int>(m_slots.size())) {
+      LOG(logERROR) << "DUT slot " << dut << " does not exist.";
+      continue;
+    }
+    node root;
+    root.slots.assign(m_slots.size(), slot_open);
+    root.slots.at(dut) = slot_dut;
+    for(size_t s = 0; s < m_slots.size(); s++) {
+      if(static_cast<int>(s) != dut) root.order.push_back(s);
+    }
+    double z = m_slots.at(dut);
+    std::stable_sort(root.order.begin(), root.order.end(), [this, z](size_t a, size_t b) {
+        return std::fabs(m_slots.at(a) - z) < std::fabs(m_slots.at(b) - z);
+      });
+    root.depth = 0;
+    root.used.assign(m_devices.size(), 0);
+    root.planes = 0;
+    frontier.push_back(root);
+  }
+
+  // Expand the first levels until there are enough subtrees to keep all threads busy:
+  const size_t tasks = 16*threadpool::global().size();
+  while(frontier.size() < tasks) {
+    std::vector<node> next;
+    bool expanded = false;
+    for(const auto& n : frontier) {
+      if(n.depth == n.order.size()) {
+        next.push_back(n);
+        continue;
+      }
+      for(auto& child : children(n, m_devices, m_minPlanes, m_maxPlanes)) next.push_back(child);
+      expanded = true;
+    }
+    frontier.swap(next);
+    if(!expanded) break;
+  }
+
+  LOG(logINFO) << "Searching " << m_slots.size() << " slots with " << m_devices.size() << " device types in "
+               << frontier.size() << " subtrees";
+
+  ranking best(k);
+  threadpool::global().parallel_for(frontier.size(), [this, &frontier, &best](size_t i) {
+      branch(frontier.at(i), best);
+    });
+
+  LOG(logINFO) << "Evaluated " << best.evaluated << " assignments, pruned " << best.pruned << " subtrees, "
+               << best.saved << " fits saved by the closed-form bound";
+  for(const auto& entry : best.get()) result.push_back(getConfiguration(entry.second, entry.first));
+  return result;
+}
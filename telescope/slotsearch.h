@@ -0,0 +1,92 @@
+#ifndef SLOTSEARCH_H
+#define SLOTSEARCH_H
+
+#include <string>
+#include <vector>
+
+#include "assembly.h"
+#include "trackmodel.h"
+
+namespace gblsim {
+
+  // Sensor type which can be mounted in a slot
+  struct device {
+    device(std::string name, double material, double resolution, unsigned int available = 100) :
+      name(name), material(material), resolution(resolution), available(available) {}
+    std::string name;
+    // Material budget x/X0 and intrinsic resolution [mm]
+    double material;
+    double resolution;
+    // Number of sensors of this type at hand
+    unsigned int available;
+  };
+
+  // Assignment of devices and the DUT to the slots
+  struct configuration {
+    // Content of every slot: index of the device type, or one of the slot_* values below
+    std::vector<int> slots;
+    // Planes of the telescope including the DUT
+    std::vector<plane> planes;
+    // Index of the DUT in the z-ordered planes
+    int dut;
+    // Track resolution at the DUT [um]
+    double resolution;
+  };
+
+  const int slot_empty = -1;
+  const int slot_dut = -2;
+
+  // Search for the best assignment of sensors to fixed mounting slots.
+  //
+  // Every slot either stays empty, holds one of the device types, or holds the DUT, and
+  // configurations are ranked by the track resolution at the DUT along the first dimension.
+  // The search is a branch-and-bound over the slots, nearest to the DUT first. The bound of a
+  // partial assignment fills all undecided slots with ideal planes without material and with
+  // the best available resolution, which can only improve the resolution since it adds
+  // information and removes scattering. The Highland factor of the bound uses the smallest total
+  // material any completion can have, since the ideal planes would otherwise lower the total of
+  // the decided layers too. A closed-form lower bound on this resolution is checked
+  // before each fit. Subtrees are distributed over the thread pool and share the current k-th
+  // best resolution for pruning.
+  class slotsearch {
+  public:
+    slotsearch(std::vector<double> slots, std::vector<device> devices, double dut_material,
+               double beam_energy, double material = X0_Air);
+
+    // Total number of sensor planes allowed, not counting the DUT. A track needs at least two.
+    void setPlanes(unsigned int min, unsigned int max);
+    // Restrict the DUT to the given slots, by default it may go into any slot
+    void setDutSlots(std::vector<int> slots) { m_dutSlots = slots; }
+
+    // Return the k best configurations, best first
+    std::vector<configuration> search(unsigned int k = 10) const;
+
+    // Resolution at the DUT for a complete assignment [um]
+    double evaluate(const std::vector<int>& slots) const;
+
+  private:
+    struct node;
+    class ranking;
+
+    // Layers for a partial assignment with ideal planes in all undecided slots, and the smallest
+    // total material of any completion, zero for complete assignments
+    std::vector<layer<double>> getLayers(const std::vector<int>& slots, size_t& dut, double& total) const;
+    // Resolution at the DUT for these layers [um]
+    double bound(const std::vector<layer<double>>& layers, size_t dut, double total = 0.) const;
+    // Continue the depth-first search from the given node
+    void branch(node& current, ranking& best) const;
+    configuration getConfiguration(const std::vector<int>& slots, double resolution) const;
+
+    std::vector<double> m_slots;
+    std::vector<device> m_devices;
+    double m_dutMaterial;
+    double m_beamEnergy;
+    double m_volumeMaterial;
+    unsigned int m_minPlanes;
+    unsigned int m_maxPlanes;
+    std::vector<int> m_dutSlots;
+  };
+
+}
+
+#endif /* SLOTSEARCH_H */
@@ -0,0 +1,112 @@
+// Inverse solver for target resolutions
+
+#include "solver.h"
+#include "log.h"
+
+#include <cmath>
+#include <limits>
+#include <utility>
+
+using namespace gblsim;
+using namespace unilog;
+
+solution gblsim::solve(const builder& build, const observable& obs, double target,
+                       double min, double max, double tolerance, unsigned int max_evaluations) {
+
+  solution result;
+  result.evaluations = 0;
+  result.converged = false;
+
+  auto residual = [&](double parameter) {
+    result.evaluations++;
+    return obs(build(parameter)) - target;
+  };
+
+  double a = min, b = max;
+  double fa = residual(a), fb = residual(b);
+  // The target is reached at an end of the interval:
+  if(fa == 0. || fb == 0.) {
+    bool upper = (fb == 0.);
+    result.parameter = (upper ? b : a);
+    result.value = target;
+    result.converged = true;
+    return result;
+  }
+  if(!std::isfinite(fa) || !std::isfinite(fb) || (fa > 0) == (fb > 0)) {
+    LOG(logERROR) << "Target " << target << " not bracketed: observable is " << fa + target
+                  << " at " << a << " and " << fb + target << " at " << b;
+    // Return the end of the interval closer to the target:
+    bool upper = std::fabs(fb) < std::fabs(fa);
+    result.parameter = (upper ? b : a);
+    result.value = (upper ? fb : fa) + target;
+    return result;
+  }
+
+  // Brent's method, b is the best estimate and [b,c] brackets the root:
+  double c = a, fc = fa;
+  double d = b - a, e = d;
+  while(true) {
+    if((fb > 0) == (fc > 0)) {
+      c = a;
+      fc = fa;
+      d = e = b - a;
+    }
+    if(std::fabs(fc) < std::fabs(fb)) {
+      a = b; b = c; c = a;
+      fa = fb; fb = fc; fc = fa;
+    }
+
+    double tol = 2*std::numeric_limits<double>::epsilon()*std::fabs(b) + 0.5*tolerance;
+    double m = 0.5*(c - b);
+    if(std::fabs(m) <= tol || fb == 0.) {
+      result.converged = true;
+      break;
+    }
+    if(result.evaluations >= max_evaluations) {
+      LOG(logWARNING) << "No convergence after " << result.evaluations << " evaluations, bracket width " << std::fabs(c - b);
+      break;
+    }
+
+    if(std::fabs(e) >= tol && std::fabs(fa) > std::fabs(fb)) {
+      // Interpolation, secant if only two distinct points are available:
+      double p, q, s = fb/fa;
+      if(a == c) {
+        p = 2*m*s;
+        q = 1 - s;
+      }
+      else {
+        double r = fb/fc;
+        q = fa/fc;
+        p = s*(2*m*q*(q - r) - (b - a)*(r - 1));
+        q = (q - 1)*(r - 1)*(s - 1);
+      }
+      if(p > 0) q = -q;
+      else p = -p;
+
+      // Accept the interpolation only if it stays well within the bracket and converges fast enough:
+      if(2*p < std::min(3*m*q - std::fabs(tol*q), std::fabs(e*q))) {
+        e = d;
+        d = p/q;
+      }
+      else {
+        d = e = m;
+      }
+    }
+    else {
+      // Bisection:
+      d = e = m;
+    }
+
+    a = b;
+    fa = fb;
+    b += (std::fabs(d) > tol ? d : (m > 0 ? tol : -tol));
+    fb = residual(b);
+    LOG(logDEBUG) << "Parameter " << b << ": observable " << fb + target;
+  }
+
+  result.parameter = b;
+  result.value = fb + target;
+  LOG(logINFO) << "Observable reaches " << result.value << " at parameter " << result.parameter
+               << " after " << result.evaluations << " evaluations";
+  return result;
+}
@@ -0,0 +1,46 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <functional>
+
+#include "assembly.h"
+
+namespace gblsim {
+
+  // Telescope as function of one free parameter, e.g. the beam energy or a plane distance
+  typedef std::function<telescope(double)> builder;
+
+  // Observable of a telescope: resolution [um] or kink resolution [urad] along the first
+  // dimension at the given plane
+  struct observable {
+    observable(int plane, bool kink = false) : plane(plane), kink(kink) {}
+    double operator()(const telescope& tel) const {
+      return (kink ? tel.getKinkResolution(plane) : tel.getResolution(plane));
+    }
+    int plane;
+    bool kink;
+  };
+
+  // Result of the inverse problem
+  struct solution {
+    // Parameter value and observable at this value
+    double parameter;
+    double value;
+    // Number of telescopes built and fitted
+    unsigned int evaluations;
+    // Whether the target was bracketed and the tolerance reached
+    bool converged;
+  };
+
+  // Find the parameter within [min, max] for which the observable takes the target value.
+  //
+  // The target has to be bracketed, i.e. the observable at both ends of the interval has to lie
+  // on different sides of it. The root is found with Brent's method, combining inverse quadratic
+  // interpolation and secant steps with bisection as safeguard, until the bracket is narrower than
+  // the tolerance on the parameter. For smooth observables this takes a handful of evaluations.
+  solution solve(const builder& build, const observable& obs, double target,
+                 double min, double max, double tolerance = 1e-6, unsigned int max_evaluations = 100);
+
+}
+
+#endif /* SOLVER_H */
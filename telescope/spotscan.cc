@@ -0,0 +1,108 @@
+// Resolution across the beam spot with material maps
+
+#include "spotscan.h"
+#include "log.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+using namespace gblsim;
+using namespace unilog;
+
+spotscan::spotscan(std::vector<plane> planes, double beam_energy, double material) :
+  m_planes(planes),
+  m_beamEnergy(beam_energy),
+  m_volumeMaterial(material),
+  m_maps(planes.size())
+{
+  // Planes are indexed in z order, as in the telescope:
+  std::stable_sort(m_planes.begin(), m_planes.end());
+}
+
+void spotscan::setMaterialMap(int plane, const map2d& map) {
+  if(plane < 0 || plane >= static_cast<int>(m_planes.size())) {
+    LOG(logERROR) << "Plane " << plane << " does not exist, cannot set its material map.";
+    return;
+  }
+  m_maps.at(plane) = map;
+}
+
+double spotscan::getMaterial(size_t plane, double x, double y) const {
+  const map2d& map = m_maps.at(plane);
+  double fx = std::floor((x - map.xmin)/map.pitch_x);
+  double fy = std::floor((y - map.ymin)/map.pitch_y);
+  if(fx < 0 || fy < 0 || fx >= map.nx || fy >= map.ny) return m_planes.at(plane).material();
+  return map(static_cast<size_t>(fx), static_cast<size_t>(fy));
+}
+
+std::vector<double> spotscan::evaluate(int plane, const map2d& grid, int axis) const {
+
+  std::vector<double> resolution(grid.values.size(), 0.);
+  if(plane < 0 || plane >= static_cast<int>(m_planes.size())) {
+    LOG(logERROR) << "Plane " << plane << " does not exist.";
+    return resolution;
+  }
+
+  // Group all cells by the material seen in every plane:
+  std::map<std::vector<double>, size_t> patterns;
+  std::vector<std::vector<double>> groups;
+  std::vector<int> group(grid.values.size(), -1);
+  for(size_t iy = 0; iy < grid.ny; iy++) {
+    for(size_t ix = 0; ix < grid.nx; ix++) {
+      if(grid(ix, iy) == 0.) continue;
+      std::vector<double> pattern(m_planes.size());
+      for(size_t p = 0; p < m_planes.size(); p++) pattern.at(p) = getMaterial(p, grid.x(ix), grid.y(iy));
+      auto it = patterns.insert(std::make_pair(pattern, groups.size()));
+      if(it.second) groups.push_back(pattern);
+      group.at(iy*grid.nx + ix) = it.first->second;
+    }
+  }
+  LOG(logINFO) << "Evaluating " << groups.size() << " distinct material patterns for "
+               << std::count_if(group.begin(), group.end(), [](int g) { return g >= 0; }) << " cells";
+
+  // Fit one telescope per group:
+  std::vector<double> values(groups.size());
+  threadpool::global().parallel_for(groups.size(), [this, &groups, &values, plane, axis](size_t g) {
+      std::vector<gblsim::plane> planes = m_planes;
+      for(size_t p = 0; p < planes.size(); p++) planes.at(p).setMaterial(groups.at(g).at(p));
+      std::pair<double,double> res = telescope(planes, m_beamEnergy, m_volumeMaterial).getResolutionXY(plane);
+      values.at(g) = (axis == 0 ? res.first : res.second);
+    });
+
+  for(size_t c = 0; c < group.size(); c++) {
+    if(group.at(c) >= 0) resolution.at(c) = values.at(group.at(c));
+  }
+  return resolution;
+}
+
+map2d spotscan::getResolutionMap(int plane, const map2d& grid, int axis) const {
+  map2d result(grid.nx, grid.ny, 1., grid.xmin, grid.ymin, grid.pitch_x, grid.pitch_y);
+  result.values = evaluate(plane, result, axis);
+  return result;
+}
+
+double spotscan::getAverageResolution(int plane, const map2d& beamspot, int axis) const {
+  std::vector<double> resolution = evaluate(plane, beamspot, axis);
+  double sum = 0, norm = 0;
+  for(size_t c = 0; c < resolution.size(); c++) {
+    sum += beamspot.values.at(c)*resolution.at(c)*resolution.at(c);
+    norm += beamspot.values.at(c);
+  }
+  return (norm > 0. ? std::sqrt(sum/norm) : 0.);
+}
+
+map2d spotscan::gaussian(const map2d& grid, double x0, double y0, double sigma_x, double sigma_y) {
+  map2d spot(grid.nx, grid.ny, 0., grid.xmin, grid.ymin, grid.pitch_x, grid.pitch_y);
+  double norm = 0;
+  for(size_t iy = 0; iy < spot.ny; iy++) {
+    for(size_t ix = 0; ix < spot.nx; ix++) {
+      double dx = (spot.x(ix) - x0)/sigma_x, dy = (spot.y(iy) - y0)/sigma_y;
+      spot(ix, iy) = std::exp(-0.5*(dx*dx + dy*dy));
+      norm += spot(ix, iy);
+    }
+  }
+  for(auto& v : spot.values) v /= norm;
+  return spot;
+}
@@ -0,0 +1,50 @@
+#ifndef SPOTSCAN_H
+#define SPOTSCAN_H
+
+#include <vector>
+
+#include "assembly.h"
+#include "map2d.h"
+
+namespace gblsim {
+
+  // Track resolution across the beam spot for planes with position-dependent material.
+  //
+  // Planes can carry a map of their material budget x/X0, e.g. for frames, bump-bond regions or
+  // cooling pipes. Tracks are assumed parallel to the beam axis and are evaluated at the centres
+  // of the cells of a grid in x and y. All cells whose tracks see the same material in every
+  // plane form one group, and each group is fitted only once. Groups are evaluated in parallel
+  // on the global thread pool.
+  class spotscan {
+  public:
+    spotscan(std::vector<plane> planes, double beam_energy, double material = X0_Air);
+
+    // Material budget map of the plane (index in the z-ordered planes). Outside of the map the
+    // material budget of the plane itself applies.
+    void setMaterialMap(int plane, const map2d& map);
+
+    // Resolution at the plane (index in the z-ordered planes) for tracks through all cells of the
+    // grid, along x (axis 0) or y (axis 1) in [um]. Only the geometry of the grid is used.
+    map2d getResolutionMap(int plane, const map2d& grid, int axis = 0) const;
+    // Width of the combined residual distribution over the beam spot, i.e. the root of the mean
+    // squared resolution weighted by the beam intensity in the cells of the given map [um]
+    double getAverageResolution(int plane, const map2d& beamspot, int axis = 0) const;
+
+    // Gaussian beam profile on the cells of the grid, normalized to one
+    static map2d gaussian(const map2d& grid, double x0, double y0, double sigma_x, double sigma_y);
+
+  private:
+    // Material budget of a plane for a track at (x,y)
+    double getMaterial(size_t plane, double x, double y) const;
+    // Resolution for all cells of the grid with non-zero weight
+    std::vector<double> evaluate(int plane, const map2d& grid, int axis) const;
+
+    std::vector<plane> m_planes;
+    double m_beamEnergy;
+    double m_volumeMaterial;
+    std::vector<map2d> m_maps;
+  };
+
+}
+
+#endif /* SPOTSCAN_H */
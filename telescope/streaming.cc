@@ -0,0 +1,180 @@
+// Streaming track resolution for large numbers of planes
+
+#include "streaming.h"
+#include "propagate.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+
+using namespace gblsim;
+using namespace unilog;
+
+namespace {
+  // Point along the trajectory
+  struct station {
+    station(double position, int label = -1) : position(position), variance(0.), measurement(false), weight(0., 0.), label(label) {}
+    double position;
+    // Variance of the kink, zero without scatterer
+    double variance;
+    bool measurement;
+    Eigen::Vector2d weight;
+    // Index of the plane labelled by this point
+    int label;
+  };
+
+  // Points of the gap in front of the plane and of the plane itself, in z-order
+  void stations(const std::vector<plane>& planes, size_t p, double beam_energy, double total, double material,
+                std::vector<station>& points) {
+    points.clear();
+    const plane& pl = planes.at(p);
+
+    // Two thin scatterers for the volume in front of the plane, as in the telescope class:
+    if(p > 0 && material > 0.0) {
+      double oldpos = planes.at(p-1).position();
+      double distance = pl.position() - oldpos;
+      for(double fraction : {0.21, 0.79}) {
+        station st(oldpos + fraction*distance);
+        st.variance = std::pow(getTheta(beam_energy, 0.5*distance/material, total), 2);
+        points.push_back(st);
+      }
+    }
+
+    if(pl.isUnknown()) {
+      // Free kinks at -+ size/sqrt(12) and a reference point in the centre:
+      double offset = pl.size()/std::sqrt(12.);
+      station centre(pl.position(), p);
+      if(offset > 0.0) {
+        for(double sign : {-1., 1.}) {
+          station kink(pl.position() + sign*offset);
+          kink.variance = 1./free_kink_precision;
+          points.push_back(kink);
+        }
+      }
+      else {
+        centre.variance = 1./free_kink_precision;
+      }
+      points.push_back(centre);
+      std::stable_sort(points.begin(), points.end(), [](const station& a, const station& b) { return a.position < b.position; });
+      return;
+    }
+
+    station st(pl.position(), p);
+    if(pl.material() > 0.0) st.variance = std::pow(getTheta(beam_energy, pl.material(), total), 2);
+    st.measurement = pl.measurement();
+    if(st.measurement) st.weight << 1./std::pow(pl.resolution().first, 2), 1./std::pow(pl.resolution().second, 2);
+    points.push_back(st);
+  }
+
+  // Information on position and slope along both axes
+  struct information {
+    information() { axis[0].setZero(); axis[1].setZero(); }
+    Eigen::Matrix2d axis[2];
+
+    // Move to a position at distance dz
+    void drift(double dz) {
+      Eigen::Matrix2d inverse;
+      inverse << 1., -dz, 0., 1.;
+      for(auto& i : axis) i = inverse.transpose()*i*inverse;
+    }
+    // Add a kink with the given variance to the slope. The update is written such that free kinks
+    // with a tiny precision do not cancel the slope information numerically:
+    void scatter(double variance) {
+      double precision = 1./variance;
+      for(auto& i : axis) {
+        double norm = i(1,1) + precision;
+        i(0,0) -= i(0,1)*i(0,1)/norm;
+        i(0,1) *= precision/norm;
+        i(1,0) = i(0,1);
+        i(1,1) *= precision/norm;
+      }
+    }
+    void measure(const Eigen::Vector2d& weight) {
+      axis[0](0,0) += weight(0);
+      axis[1](0,0) += weight(1);
+    }
+  };
+
+  // Position variance from the information matrix, infinite if the position is not determined
+  double variance(const Eigen::Matrix2d& i) {
+    double det = i.determinant();
+    return (det > 0. ? i(1,1)/det : std::numeric_limits<double>::infinity());
+  }
+}
+
+std::vector<std::pair<double,double>> gblsim::getResolutionsXY(const std::vector<plane>& planes, const std::vector<int>& selected,
+                                                               double beam_energy, double material) {
+
+  std::vector<std::pair<double,double>> result(selected.size(), std::make_pair(0., 0.));
+  if(planes.empty()) return result;
+
+  // Only sort if needed:
+  std::vector<plane> sorted;
+  const bool ordered = std::is_sorted(planes.begin(), planes.end());
+  if(!ordered) {
+    sorted = planes;
+    std::stable_sort(sorted.begin(), sorted.end());
+  }
+  const std::vector<plane>& pl = (ordered ? planes : sorted);
+
+  std::map<int, size_t> slot;
+  for(size_t s = 0; s < selected.size(); s++) {
+    if(selected.at(s) < 0 || selected.at(s) >= static_cast<int>(pl.size())) {
+      LOG(logERROR) << "Plane " << selected.at(s) << " does not exist.";
+      continue;
+    }
+    // Planes selected more than once are computed for their first entry:
+    slot.insert(std::make_pair(selected.at(s), s));
+  }
+
+  // Total material budget for the Highland formula:
+  double total = 0;
+  for(const auto& p : pl) total += p.material();
+  if(material > 0.0) total += (pl.back().position() - pl.front().position())/material;
+
+  std::vector<station> points;
+  std::vector<information> forward(selected.size());
+
+  // Forward filter, storing the information including the measurement but before the kink:
+  information info;
+  double z = pl.front().position();
+  for(size_t p = 0; p < pl.size(); p++) {
+    stations(pl, p, beam_energy, total, material, points);
+    for(const auto& st : points) {
+      info.drift(st.position - z);
+      z = st.position;
+      if(st.measurement) info.measure(st.weight);
+      if(st.label >= 0 && slot.count(st.label)) forward.at(slot[st.label]) = info;
+      if(st.variance > 0.0) info.scatter(st.variance);
+    }
+  }
+
+  // Backward filter, combined with the forward information at the selected planes:
+  info = information();
+  z = pl.back().position();
+  for(size_t p = pl.size(); p-- > 0; ) {
+    stations(pl, p, beam_energy, total, material, points);
+    for(auto st = points.rbegin(); st != points.rend(); st++) {
+      info.drift(st->position - z);
+      z = st->position;
+      if(st->label >= 0 && slot.count(st->label)) {
+        // Information from downstream on the state before the kink:
+        information backward = info;
+        if(st->variance > 0.0) backward.scatter(st->variance);
+        const information& upstream = forward.at(slot[st->label]);
+        result.at(slot[st->label]) = std::make_pair(std::sqrt(variance(upstream.axis[0] + backward.axis[0]))*1E3,
+                                                    std::sqrt(variance(upstream.axis[1] + backward.axis[1]))*1E3);
+      }
+      if(st->measurement) info.measure(st->weight);
+      if(st->variance > 0.0) info.scatter(st->variance);
+    }
+  }
+
+  for(size_t s = 0; s < selected.size(); s++) {
+    auto first = slot.find(selected.at(s));
+    if(first != slot.end()) result.at(s) = result.at(first->second);
+  }
+  return result;
+}
@@ -0,0 +1,26 @@
+#ifndef STREAMING_H
+#define STREAMING_H
+
+#include <utility>
+#include <vector>
+
+#include "assembly.h"
+
+namespace gblsim {
+
+  // Resolution in both dimensions at the selected planes (indices in the z-ordered planes) for
+  // geometries with many planes, e.g. layered trackers or segmented targets.
+  //
+  // The trajectory is described by the same points as in the telescope class, but they are never
+  // stored: a forward and a backward information filter on position and slope run along the
+  // planes, generating the points of every gap on the fly, and their information is combined at
+  // the selected planes. The work is linear in the number of planes for z-ordered input, and the
+  // memory beyond the plane vector only grows with the number of selected planes. Unknown
+  // scatterers must not extend beyond their neighbouring planes. A plane selected more than
+  // once gets its result at every entry.
+  std::vector<std::pair<double,double>> getResolutionsXY(const std::vector<plane>& planes, const std::vector<int>& selected,
+                                                         double beam_energy, double material = X0_Air);
+
+}
+
+#endif /* STREAMING_H */
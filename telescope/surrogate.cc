@@ -0,0 +1,253 @@
+// Surrogate lookup tables for fast resolution queries
+
+#include "surrogate.h"
+#include "log.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+using namespace gblsim;
+using namespace unilog;
+
+namespace {
+  // File format identifier and version:
+  const char surrogate_magic[4] = {'T', 'R', 'S', 'G'};
+  const uint32_t surrogate_version = 1;
+
+  template <typename T> void write_value(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+  template <typename T> bool read_value(std::ifstream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+  }
+}
+
+surrogate::surrogate() : m_axes(), m_values(), m_errors(), m_fallbacks(0) {}
+
+surrogate::surrogate(const surrogate& other) :
+  m_axes(other.m_axes), m_values(other.m_values), m_errors(other.m_errors), m_fallbacks(other.m_fallbacks.load()) {}
+
+surrogate& surrogate::operator=(const surrogate& other) {
+  m_axes = other.m_axes;
+  m_values = other.m_values;
+  m_errors = other.m_errors;
+  m_fallbacks = other.m_fallbacks.load();
+  return *this;
+}
+
+surrogate surrogate::build(const std::vector<axis>& axes, const evaluator& model) {
+
+  surrogate sg;
+  sg.m_axes = axes;
+
+  size_t nodes = 1, cells = 1;
+  for(const auto& ax : axes) {
+    if(ax.nodes < 2 || !(ax.max > ax.min)) {
+      LOG(logERROR) << "Axis " << ax.name << " needs at least two nodes and a non-empty range, cannot build surrogate.";
+      return surrogate();
+    }
+    nodes *= ax.nodes;
+    cells *= (ax.nodes - 1);
+  }
+  LOG(logINFO) << "Sampling " << nodes << " nodes and " << cells << " cell centres in " << axes.size() << " dimensions";
+
+  sg.m_values.resize(nodes);
+  sg.m_errors.resize(cells);
+
+  // Evaluate the observable at all nodes:
+  threadpool::global().parallel_for(nodes, [&sg, &model](size_t n) {
+      std::vector<double> point(sg.m_axes.size());
+      size_t flat = n;
+      for(size_t d = 0; d < sg.m_axes.size(); d++) {
+        const axis& ax = sg.m_axes.at(d);
+        point.at(d) = ax.min + (flat % ax.nodes)*(ax.max - ax.min)/(ax.nodes - 1);
+        flat /= ax.nodes;
+      }
+      sg.m_values.at(n) = model(point);
+    });
+
+  // Compare interpolation and full evaluation at all cell centres:
+  threadpool::global().parallel_for(cells, [&sg, &model](size_t c) {
+      std::vector<double> point(sg.m_axes.size());
+      size_t flat = c;
+      for(size_t d = 0; d < sg.m_axes.size(); d++) {
+        const axis& ax = sg.m_axes.at(d);
+        point.at(d) = ax.min + (flat % (ax.nodes - 1) + 0.5)*(ax.max - ax.min)/(ax.nodes - 1);
+        flat /= (ax.nodes - 1);
+      }
+      sg.m_errors.at(c) = std::fabs(sg.evaluate(point) - model(point));
+    });
+
+  LOG(logINFO) << "Surrogate built, maximum interpolation error " << sg.getMaxError();
+  return sg;
+}
+
+bool surrogate::write(const std::string& filename) const {
+
+  std::ofstream out(filename.c_str(), std::ios::binary);
+  if(!out) {
+    LOG(logERROR) << "Cannot open " << filename << " for writing.";
+    return false;
+  }
+
+  out.write(surrogate_magic, sizeof(surrogate_magic));
+  write_value(out, surrogate_version);
+  write_value(out, static_cast<uint32_t>(m_axes.size()));
+  for(const auto& ax : m_axes) {
+    write_value(out, static_cast<uint32_t>(ax.name.size()));
+    out.write(ax.name.data(), ax.name.size());
+    write_value(out, ax.min);
+    write_value(out, ax.max);
+    write_value(out, static_cast<uint32_t>(ax.nodes));
+  }
+  out.write(reinterpret_cast<const char*>(m_values.data()), m_values.size()*sizeof(double));
+  out.write(reinterpret_cast<const char*>(m_errors.data()), m_errors.size()*sizeof(float));
+
+  LOG(logINFO) << "Wrote surrogate with " << m_values.size() << " nodes to " << filename;
+  return static_cast<bool>(out);
+}
+
+surrogate surrogate::read(const std::string& filename) {
+
+  std::ifstream in(filename.c_str(), std::ios::binary | std::ios::ate);
+  surrogate sg;
+
+  // Sizes read from the file are checked against the remaining bytes before allocating:
+  const std::streamoff size = (in ? static_cast<std::streamoff>(in.tellg()) : 0);
+  in.seekg(0);
+  auto remaining = [&in, size]() { return static_cast<size_t>(size - in.tellg()); };
+
+  char magic[4];
+  uint32_t version = 0, dimensions = 0;
+  // Every axis takes at least its name length, range and node count:
+  const size_t axis_size = 2*sizeof(uint32_t) + 2*sizeof(double);
+  if(!in.read(magic, sizeof(magic)) || std::memcmp(magic, surrogate_magic, sizeof(magic)) != 0
+     || !read_value(in, version) || version != surrogate_version || !read_value(in, dimensions)
+     || dimensions > remaining()/axis_size) {
+    LOG(logERROR) << "Cannot read surrogate from " << filename << ", falling back to full evaluation.";
+    return surrogate();
+  }
+
+  size_t nodes = 1, cells = 1;
+  for(uint32_t d = 0; d < dimensions; d++) {
+    uint32_t length = 0, count = 0;
+    axis ax;
+    bool valid = read_value(in, length) && length <= remaining();
+    if(valid) ax.name.resize(length);
+    valid = valid && in.read(&ax.name[0], length) && read_value(in, ax.min) && read_value(in, ax.max)
+      && read_value(in, count) && count >= 2 && nodes <= remaining()/sizeof(double)/count;
+    if(!valid) {
+      LOG(logERROR) << "Corrupt axis definition in " << filename << ", falling back to full evaluation.";
+      return surrogate();
+    }
+    ax.nodes = count;
+    nodes *= ax.nodes;
+    cells *= (ax.nodes - 1);
+    sg.m_axes.push_back(ax);
+  }
+
+  if(nodes*sizeof(double) + cells*sizeof(float) > remaining()) {
+    LOG(logERROR) << "Truncated surrogate table in " << filename << ", falling back to full evaluation.";
+    return surrogate();
+  }
+  sg.m_values.resize(nodes);
+  sg.m_errors.resize(cells);
+  if(!in.read(reinterpret_cast<char*>(sg.m_values.data()), nodes*sizeof(double))
+     || !in.read(reinterpret_cast<char*>(sg.m_errors.data()), cells*sizeof(float))) {
+    LOG(logERROR) << "Truncated surrogate table in " << filename << ", falling back to full evaluation.";
+    return surrogate();
+  }
+
+  LOG(logINFO) << "Read surrogate with " << nodes << " nodes from " << filename;
+  return sg;
+}
+
+bool surrogate::contains(const std::vector<double>& point) const {
+  if(m_axes.empty() || point.size() != m_axes.size()) return false;
+  for(size_t d = 0; d < m_axes.size(); d++) {
+    if(!(point.at(d) >= m_axes.at(d).min && point.at(d) <= m_axes.at(d).max)) return false;
+  }
+  return true;
+}
+
+size_t surrogate::node(const std::vector<unsigned int>& index) const {
+  size_t flat = 0, stride = 1;
+  for(size_t d = 0; d < index.size(); d++) {
+    flat += index.at(d)*stride;
+    stride *= m_axes.at(d).nodes;
+  }
+  return flat;
+}
+
+size_t surrogate::cell(const std::vector<unsigned int>& index) const {
+  size_t flat = 0, stride = 1;
+  for(size_t d = 0; d < index.size(); d++) {
+    flat += index.at(d)*stride;
+    stride *= (m_axes.at(d).nodes - 1);
+  }
+  return flat;
+}
+
+size_t surrogate::locate(const std::vector<double>& point, std::vector<double>& fraction) const {
+  std::vector<unsigned int> index(m_axes.size());
+  fraction.resize(m_axes.size());
+  for(size_t d = 0; d < m_axes.size(); d++) {
+    const axis& ax = m_axes.at(d);
+    double t = (point.at(d) - ax.min)/(ax.max - ax.min)*(ax.nodes - 1);
+    unsigned int i = std::min(static_cast<unsigned int>(std::max(t, 0.)), ax.nodes - 2);
+    index.at(d) = i;
+    fraction.at(d) = t - i;
+  }
+  return cell(index);
+}
+
+double surrogate::evaluate(const std::vector<double>& point) const {
+
+  std::vector<double> fraction;
+  size_t c = locate(point, fraction);
+
+  // Recover the lower corner node of the cell:
+  std::vector<unsigned int> corner(m_axes.size());
+  for(size_t d = 0; d < m_axes.size(); d++) {
+    corner.at(d) = c % (m_axes.at(d).nodes - 1);
+    c /= (m_axes.at(d).nodes - 1);
+  }
+  size_t base = node(corner);
+
+  // Sum over all 2^d corners of the cell with multilinear weights:
+  double value = 0;
+  for(size_t k = 0; k < (static_cast<size_t>(1) << m_axes.size()); k++) {
+    double weight = 1.;
+    size_t offset = 0, stride = 1;
+    for(size_t d = 0; d < m_axes.size(); d++) {
+      bool upper = (k >> d) & 1;
+      weight *= (upper ? fraction.at(d) : 1. - fraction.at(d));
+      if(upper) offset += stride;
+      stride *= m_axes.at(d).nodes;
+    }
+    value += weight*m_values[base + offset];
+  }
+  return value;
+}
+
+double surrogate::getError(const std::vector<double>& point) const {
+  std::vector<double> fraction;
+  return m_errors.at(locate(point, fraction));
+}
+
+double surrogate::getMaxError() const {
+  return (m_errors.empty() ? 0. : *std::max_element(m_errors.begin(), m_errors.end()));
+}
+
+double surrogate::query(const std::vector<double>& point, double tolerance, const evaluator& fallback) const {
+  if(contains(point) && getError(point) <= tolerance) {
+    return evaluate(point);
+  }
+  m_fallbacks++;
+  LOG(logDEBUG) << "Surrogate query outside validated region, using full evaluation";
+  return fallback(point);
+}
@@ -0,0 +1,77 @@
+#ifndef SURROGATE_H
+#define SURROGATE_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace gblsim {
+
+  // Full evaluation of an observable (e.g. the resolution at the DUT) at a point in parameter space,
+  // typically building a telescope from the parameters and fitting it
+  typedef std::function<double(const std::vector<double>&)> evaluator;
+
+  // Parameter range sampled on equidistant nodes
+  struct axis {
+    axis(std::string name = "", double min = 0., double max = 1., unsigned int nodes = 2) :
+      name(name), min(min), max(max), nodes(nodes) {}
+    std::string name;
+    double min;
+    double max;
+    unsigned int nodes;
+  };
+
+  // Multilinear interpolation of an observable on a regular grid in a parameter box.
+  //
+  // The observable is evaluated at all grid nodes. The interpolation error of each grid cell is
+  // estimated by an additional full evaluation at the cell centre. Queries outside the box or in
+  // cells with an error estimate above the requested tolerance fall back to the full evaluation.
+  class surrogate {
+  public:
+    surrogate();
+    surrogate(const surrogate& other);
+    surrogate& operator=(const surrogate& other);
+
+    // Sample the parameter box with the full evaluation, using all threads of the global pool
+    static surrogate build(const std::vector<axis>& axes, const evaluator& model);
+
+    // Write to and read from a compact binary file. Reading a missing or corrupt file
+    // yields an empty surrogate for which all queries fall back to the full evaluation.
+    bool write(const std::string& filename) const;
+    static surrogate read(const std::string& filename);
+
+    const std::vector<axis>& getAxes() const { return m_axes; }
+    // Whether the point lies within the validated parameter box
+    bool contains(const std::vector<double>& point) const;
+    // Interpolated value at a point inside the box
+    double evaluate(const std::vector<double>& point) const;
+    // Estimated interpolation error at a point inside the box
+    double getError(const std::vector<double>& point) const;
+    // Maximum estimated interpolation error over the box
+    double getMaxError() const;
+
+    // Interpolate, or call the fallback if the point is outside the box or the error estimate
+    // exceeds the tolerance
+    double query(const std::vector<double>& point, double tolerance, const evaluator& fallback) const;
+    // Number of queries answered by the fallback
+    size_t getFallbacks() const { return m_fallbacks; }
+
+  private:
+    // Locate the cell of the point and the fractional position inside of it
+    size_t locate(const std::vector<double>& point, std::vector<double>& fraction) const;
+    // Convert between flat and per-axis indices
+    size_t node(const std::vector<unsigned int>& index) const;
+    size_t cell(const std::vector<unsigned int>& index) const;
+
+    std::vector<axis> m_axes;
+    // Observable at all nodes and error estimates for all cells, first axis running fastest
+    std::vector<double> m_values;
+    std::vector<float> m_errors;
+
+    mutable std::atomic<size_t> m_fallbacks;
+  };
+
+}
+
+#endif /* SURROGATE_H */
@@ -0,0 +1,292 @@
+// Toy Monte Carlo validation of the predicted resolution
+
+#include "toymc.h"
+#include "cache.h"
+#include "trackmodel.h"
+#include "log.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <random>
+#include <sstream>
+
+using namespace gblsim;
+using namespace unilog;
+
+namespace {
+  // Number of tracks generated and fitted together:
+  const size_t batch_size = 4096;
+  // Number of batches per block, the unit of shards and checkpoints:
+  const size_t block_batches = 256;
+
+  // Residual statistics of a batch, block or run
+  struct accumulator {
+    explicit accumulator(double predicted) :
+      tracks(0),
+      residuals(200, -8*predicted, 8*predicted),
+      stats(),
+      quantiles(),
+      core(-5*predicted, 5*predicted) {}
+
+    void fill(double residual) {
+      residuals.fill(residual);
+      stats.fill(residual);
+      quantiles.fill(residual);
+      core.fill(residual);
+    }
+    void add(const accumulator& other) {
+      tracks += other.tracks;
+      residuals.add(other.residuals);
+      stats.add(other.stats);
+      quantiles.add(other.quantiles);
+      core.add(other.core);
+    }
+
+    std::vector<double> save() const {
+      std::vector<double> state(1, static_cast<double>(tracks));
+      residuals.save(state);
+      stats.save(state);
+      quantiles.save(state);
+      core.save(state);
+      return state;
+    }
+    bool load(const std::vector<double>& state) {
+      if(state.empty()) return false;
+      const double* data = state.data() + 1;
+      const double* end = state.data() + state.size();
+      tracks = static_cast<size_t>(state[0]);
+      return residuals.load(data, end) && stats.load(data, end) && quantiles.load(data, end) && core.load(data, end)
+        && data == end;
+    }
+
+    size_t tracks;
+    histogram residuals;
+    moments stats;
+    tdigest quantiles;
+    gaussfit core;
+  };
+
+  // Resolution at the plane in [um] predicted from the covariance of the GBL trajectory
+  double predict(const std::vector<plane>& planes, double beam_energy, double material, int plane) {
+    telescope tel(planes, beam_energy, material);
+    return tel.getResolution(plane);
+  }
+
+  validation empty() {
+    validation result;
+    result.tracks = 0;
+    result.predicted = 0;
+    result.mean = result.rms = result.rms_error = result.quantile_width = 0;
+    result.core = gaussfit().fit();
+    return result;
+  }
+}
+
+toymc::toymc(std::vector<plane> planes, double beam_energy, double material) :
+  m_planes(planes),
+  m_beamEnergy(beam_energy),
+  m_volumeMaterial(material),
+  m_tailProbability(0.),
+  m_tailScale(1.),
+  m_monitor()
+{
+  // Planes are indexed in z order, as in the telescope:
+  std::stable_sort(m_planes.begin(), m_planes.end());
+}
+
+std::string toymc::describe(int plane, size_t tracks, unsigned int seed) const {
+  std::ostringstream out;
+  out << resultcache::describe(m_planes, m_beamEnergy, m_volumeMaterial, "toymc") << "plane " << plane
+      << " tracks " << tracks << " seed " << seed << " tails " << m_tailProbability << " " << m_tailScale;
+  return out.str();
+}
+
+size_t toymc::getBlocks(size_t tracks) {
+  return (tracks + batch_size*block_batches - 1)/(batch_size*block_batches);
+}
+
+validation toymc::run(int plane, size_t tracks, unsigned int seed) const {
+  checkpoint blocks(describe(plane, tracks, seed), getBlocks(tracks));
+  if(!runShard(plane, tracks, seed, shard(), blocks)) return empty();
+  return merge(plane, tracks, blocks);
+}
+
+bool toymc::runShard(int plane, size_t tracks, unsigned int seed, const shard& part, checkpoint& blocks) const {
+
+  if(plane < 0 || plane >= static_cast<int>(m_planes.size())) {
+    LOG(logERROR) << "Plane " << plane << " does not exist.";
+    return false;
+  }
+  if(blocks.getItems() != getBlocks(tracks)) {
+    LOG(logERROR) << "Checkpoint does not match the number of tracks.";
+    return false;
+  }
+
+  // Tracks are generated from the native track model with the Highland widths, and fitted with the
+  // weights of the points of the GBL trajectory. The residuals are compared with the covariance of
+  // the GBL fit, so any disagreement between the trajectory and the scattering shows up.
+  std::vector<layer<double>> layers;
+  for(const auto& pl : m_planes) layers.push_back(layer<double>(pl));
+  trackmodel<double> model(layers, m_beamEnergy, m_volumeMaterial);
+  telescope tel(m_planes, m_beamEnergy, m_volumeMaterial);
+  const double predicted = tel.getResolution(plane);
+
+  // Generated scatterers and measurements along the trajectory:
+  const auto& points = model.getPoints();
+  std::vector<double> kinks, widths, hits, resolutions;
+  double target = 0;
+  for(const auto& p : points) {
+    if(p.kink >= 0 && p.unknown < 0) {
+      kinks.push_back(p.position);
+      widths.push_back(1./std::sqrt(p.precision));
+    }
+    if(p.measurement) {
+      hits.push_back(p.position);
+      resolutions.push_back(1./std::sqrt(p.weight));
+    }
+    if(p.layer == plane) target = p.position;
+  }
+
+  // Scatterers and measurements of the fit, kinks are only defined at inner points:
+  const auto& gblpoints = tel.getPoints();
+  const auto& positions = tel.getPointPositions();
+  std::vector<double> fit_kinks, fit_precisions, fit_hits, fit_weights;
+  for(size_t p = 0; p < gblpoints.size(); p++) {
+    if(p > 0 && p + 1 < gblpoints.size() && gblpoints[p].hasScatterer()) {
+      Eigen::Matrix2d transformation;
+      Eigen::Vector2d residual, precision;
+      gblpoints[p].getScatterer(transformation, residual, precision);
+      fit_kinks.push_back(positions[p]);
+      fit_precisions.push_back(precision(0));
+    }
+    if(unsigned int dimension = gblpoints[p].hasMeasurement()) {
+      Eigen::Matrix<double,5,5> projection;
+      Eigen::Matrix<double,5,1> residual, precision;
+      gblpoints[p].getMeasurement(projection, residual, precision);
+      fit_hits.push_back(positions[p]);
+      fit_weights.push_back(precision(5 - dimension));
+    }
+  }
+  if(fit_hits.size() != hits.size()) {
+    LOG(logERROR) << "Trajectory has " << fit_hits.size() << " measurements, the track model " << hits.size();
+    return false;
+  }
+
+  // Track positions as linear function of offset, slope and all kinks:
+  const double z0 = points.front().position;
+  auto derivatives = [z0](const std::vector<double>& scatterers, double z) {
+    Eigen::RowVectorXd d(2 + scatterers.size());
+    d(0) = 1.;
+    d(1) = z - z0;
+    for(size_t k = 0; k < scatterers.size(); k++) d(2 + k) = std::max(z - scatterers.at(k), 0.);
+    return d;
+  };
+  Eigen::MatrixXd measured(hits.size(), 2 + kinks.size());
+  for(size_t h = 0; h < hits.size(); h++) measured.row(h) = derivatives(kinks, hits.at(h));
+  Eigen::RowVectorXd truth = derivatives(kinks, target);
+
+  // Linear fit of the hits with the kink priors of the trajectory, its estimate at the plane is a
+  // fixed weighted sum of the hits:
+  Eigen::MatrixXd fitted(fit_hits.size(), 2 + fit_kinks.size());
+  for(size_t h = 0; h < fit_hits.size(); h++) fitted.row(h) = derivatives(fit_kinks, fit_hits.at(h));
+  Eigen::VectorXd weights = Eigen::Map<const Eigen::VectorXd>(fit_weights.data(), fit_weights.size());
+  Eigen::MatrixXd information = fitted.transpose()*weights.asDiagonal()*fitted;
+  for(size_t k = 0; k < fit_kinks.size(); k++) information(2 + k, 2 + k) += fit_precisions.at(k);
+  Eigen::RowVectorXd estimate = derivatives(fit_kinks, positions.at(tel.getPointIndex(plane)));
+  Eigen::RowVectorXd gain = information.ldlt().solve(estimate.transpose()).transpose()*fitted.transpose()*weights.asDiagonal();
+
+  const size_t first = part.begin(blocks.getItems()), last = part.end(blocks.getItems());
+  LOG(logINFO) << "Generating blocks " << first << " to " << last << " of " << blocks.getItems() << " with "
+               << kinks.size() << " scatterers and " << hits.size() << " measurements";
+
+  // Running histogram of this shard for the monitor:
+  std::mutex mutex;
+  accumulator monitored(predicted);
+  const size_t batches = (tracks + batch_size - 1)/batch_size;
+
+  for(size_t block = first; block < last; block++) {
+    if(blocks.has(block)) continue;
+    const size_t begin = block*block_batches, end = std::min(batches, begin + block_batches);
+    std::vector<accumulator> results(end - begin, accumulator(predicted));
+
+    threadpool::global().parallel_for(end - begin, [&](size_t i) {
+        const size_t b = begin + i;
+        const size_t n = std::min(batch_size, tracks - b*batch_size);
+        std::mt19937_64 generator(static_cast<uint64_t>(seed)*1000003 + b);
+        std::normal_distribution<double> gauss;
+        std::uniform_real_distribution<double> uniform;
+
+        // Track parameters: offset [mm], slope and kinks [rad]
+        Eigen::MatrixXd parameters(2 + kinks.size(), n);
+        for(size_t t = 0; t < n; t++) {
+          parameters(0, t) = gauss(generator);
+          parameters(1, t) = 1e-3*gauss(generator);
+          for(size_t k = 0; k < kinks.size(); k++) {
+            double scale = (m_tailProbability > 0. && uniform(generator) < m_tailProbability ? m_tailScale : 1.);
+            parameters(2 + k, t) = scale*widths.at(k)*gauss(generator);
+          }
+        }
+
+        // Smeared hits and the fitted positions at the plane:
+        Eigen::MatrixXd measurements = measured*parameters;
+        for(size_t t = 0; t < n; t++) {
+          for(size_t h = 0; h < hits.size(); h++) measurements(h, t) += resolutions.at(h)*gauss(generator);
+        }
+        Eigen::RowVectorXd residuals = (gain*measurements - truth*parameters)*1E3;
+
+        accumulator& local = results[i];
+        local.tracks = n;
+        for(size_t t = 0; t < n; t++) local.fill(residuals(t));
+
+        if(!m_monitor) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        monitored.tracks += n;
+        monitored.residuals.add(local.residuals);
+        m_monitor(monitored.residuals, monitored.tracks);
+      });
+
+    // Batches are merged in order, independent of the thread which finished first:
+    accumulator merged(predicted);
+    for(const auto& r : results) merged.add(r);
+    if(!blocks.put(block, merged.save())) return false;
+  }
+  return blocks.save();
+}
+
+validation toymc::merge(int plane, size_t tracks, const checkpoint& blocks) const {
+  validation result = empty();
+  if(plane < 0 || plane >= static_cast<int>(m_planes.size()) || blocks.getItems() != getBlocks(tracks)) {
+    LOG(logERROR) << "Plane " << plane << " or checkpoint does not match the run.";
+    return result;
+  }
+  if(!blocks.complete()) {
+    LOG(logERROR) << "Only " << blocks.getCompleted() << " of " << blocks.getItems() << " blocks are complete.";
+    return result;
+  }
+
+  result.predicted = predict(m_planes, m_beamEnergy, m_volumeMaterial, plane);
+  accumulator total(result.predicted);
+  for(size_t block = 0; block < blocks.getItems(); block++) {
+    accumulator part(result.predicted);
+    if(!part.load(blocks.get(block))) {
+      LOG(logERROR) << "Block " << block << " of the checkpoint is corrupt.";
+      return empty();
+    }
+    total.add(part);
+  }
+
+  result.tracks = total.tracks;
+  result.residuals = total.residuals;
+  if(result.tracks > 0) {
+    result.mean = total.stats.mean();
+    result.rms = total.stats.rms();
+    result.rms_error = result.rms/std::sqrt(2.*result.tracks);
+    result.core = total.core.fit();
+    result.quantile_width = 0.5*(total.quantiles.quantile(0.841345) - total.quantiles.quantile(0.158655));
+  }
+  LOG(logINFO) << "Residual RMS " << result.rms << " +- " << result.rms_error << "um, core fit " << result.core.sigma
+               << " +- " << result.core.sigma_error << "um, predicted " << result.predicted << "um";
+  return result;
+}
@@ -0,0 +1,83 @@
+#ifndef TOYMC_H
+#define TOYMC_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "assembly.h"
+#include "histogram.h"
+#include "shards.h"
+#include "statistics.h"
+
+namespace gblsim {
+
+  // Comparison of fitted toy tracks with the predicted resolution, all in [um]
+  struct validation {
+    size_t tracks;
+    // Resolution predicted by the covariance of the GBL trajectory
+    double predicted;
+    // Mean and RMS of the residuals between fitted and true track position, and the
+    // statistical uncertainty of the RMS
+    double mean;
+    double rms;
+    double rms_error;
+    // Unbinned Gaussian fit to the residuals within -+5 times the predicted resolution
+    gaussfit::result core;
+    // Half width of the central 68.3% interval of the residuals
+    double quantile_width;
+    // Residual distribution in the range of -+8 times the predicted resolution
+    histogram residuals;
+  };
+
+  // Toy Monte Carlo validation of the predicted track resolution along the first dimension.
+  //
+  // Straight tracks are generated with the native track model, with a random kink at every
+  // scatterer drawn with the Highland width, and the hits are smeared with the intrinsic
+  // resolution of each plane. Unknown scatterers do not scatter. Each track is fitted with the
+  // scatterer and measurement precisions of the points of the GBL trajectory, whose estimate at a
+  // plane is a fixed weighted sum of the hits, and the residuals to the true track position are
+  // compared with the resolution from the covariance of the GBL fit. Tracks are processed in batches
+  // as matrices on the global thread pool, and batches are reproducible for a given seed
+  // independent of the number of threads.
+  //
+  // Batches are merged in order into blocks of 2^20 tracks, and blocks in order into the result,
+  // so results are identical for any number of threads. Long runs can be split into shards of
+  // blocks, run as separate processes with checkpoints, and merged into exactly the result of
+  // a single run.
+  class toymc {
+  public:
+    toymc(std::vector<plane> planes, double beam_energy, double material = X0_Air);
+
+    // Non-Gaussian tails of the scattering angle distribution as in the Moliere theory: with the
+    // given probability, a kink is drawn with scale times the Highland width
+    void setTails(double probability, double scale) { m_tailProbability = probability; m_tailScale = scale; }
+
+    // Function called after every batch with the residual histogram so far and the number of tracks
+    typedef std::function<void(const histogram&, size_t)> monitor;
+    void setMonitor(const monitor& callback) { m_monitor = callback; }
+
+    // Generate and fit the given number of tracks, and compare the residuals at the plane (index
+    // in the z-ordered planes) with the predicted resolution
+    validation run(int plane, size_t tracks, unsigned int seed = 0) const;
+
+    // Description of a run for checkpoints, and its number of blocks
+    std::string describe(int plane, size_t tracks, unsigned int seed) const;
+    static size_t getBlocks(size_t tracks);
+    // Generate the blocks of one shard which are missing in the checkpoint and store them
+    bool runShard(int plane, size_t tracks, unsigned int seed, const shard& part, checkpoint& blocks) const;
+    // Result from a checkpoint with all blocks, e.g. merged from all shards
+    validation merge(int plane, size_t tracks, const checkpoint& blocks) const;
+
+  private:
+    std::vector<plane> m_planes;
+    double m_beamEnergy;
+    double m_volumeMaterial;
+    double m_tailProbability;
+    double m_tailScale;
+    monitor m_monitor;
+  };
+
+}
+
+#endif /* TOYMC_H */
@@ -0,0 +1,199 @@
+#ifndef TRACKMODEL_H
+#define TRACKMODEL_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <unsupported/Eigen/AutoDiff>
+
+#include "assembly.h"
+
+namespace gblsim {
+
+  // Plane description for the native track model, with the scalar type of positions,
+  // materials and resolutions as template parameter to allow automatic differentiation
+  template <typename T>
+  struct layer {
+    layer() : position(0.), material(0.), resolution(0.), measurement(false), size(-1.) {}
+    // Take the first dimension of a telescope plane:
+    explicit layer(const plane& pl) :
+      position(pl.position()), material(pl.material()), resolution(std::get<0>(pl.resolution())),
+      measurement(pl.measurement()), size(pl.size()) {}
+
+    T position;
+    T material;
+    T resolution;
+    bool measurement;
+    // Size of an unknown scatterer, negative for all other planes
+    double size;
+    bool isUnknown() const { return !measurement && size >= 0.0; }
+  };
+
+  // Plain value of a (possibly differentiated) scalar
+  inline double value_of(double x) { return x; }
+  template <typename D> double value_of(const Eigen::AutoDiffScalar<D>& x) { return x.value(); }
+
+  // Native dense straight-line track model along one dimension.
+  //
+  // The trajectory is built from the same points as the GBL trajectory of the telescope class:
+  // two volume scatterers at 0.21 and 0.79 of every gap, free kinks for unknown scatterers, and
+  // scattering according to the Highland formula with the total material budget. Track parameters
+  // are offset and slope at the first point plus one kink per inner scatterer, and variances
+  // follow from the factorized information matrix. With an automatic differentiation scalar type,
+  // all results carry exact derivatives with respect to the input parameters.
+  template <typename T>
+  class trackmodel {
+  public:
+    typedef Eigen::Matrix<T, Eigen::Dynamic, 1> Vector;
+    typedef Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> Matrix;
+
+    // The total material budget of the Highland formula is taken from the layers unless given
+    trackmodel(const std::vector<layer<T>>& layers, const T& beam_energy, double volume_material = X0_Air,
+               double total_material = 0.) :
+      m_parameters(2), m_label(layers.size()), m_kinks(layers.size()) {
+
+      using std::log;
+      using std::sqrt;
+
+      // Order the layers in z:
+      std::vector<size_t> order(layers.size());
+      for(size_t l = 0; l < order.size(); l++) order[l] = l;
+      std::stable_sort(order.begin(), order.end(), [&layers](size_t a, size_t b) {
+          return value_of(layers[a].position) < value_of(layers[b].position);
+        });
+
+      // Total material budget of the track:
+      T total = T(0.);
+      for(const auto& l : layers) total += l.material;
+      if(volume_material > 0.0) {
+        total += (layers[order.back()].position - layers[order.front()].position)/volume_material;
+      }
+      if(total_material > 0.0) total = T(total_material);
+      T highland = 0.0136/beam_energy*(1. + 0.038*log(total));
+
+      // Collect all points, precision of the kink is zero for points without scatterer:
+      std::vector<point> points;
+      for(size_t o = 0; o < order.size(); o++) {
+        const layer<T>& l = layers[order[o]];
+        if(o > 0 && volume_material > 0.0) {
+          const T& oldpos = layers[order[o-1]].position;
+          T distance = l.position - oldpos;
+          for(double fraction : {0.21, 0.79}) {
+            T theta = highland*sqrt(0.5*distance/volume_material);
+            points.push_back(point(oldpos + fraction*distance, -1, 1./(theta*theta)));
+          }
+        }
+        if(l.isUnknown()) {
+          double offset = l.size/std::sqrt(12.);
+          if(offset > 0.0) {
+            points.push_back(point(l.position - offset, -1, T(free_kink_precision), order[o]));
+            points.push_back(point(l.position + offset, -1, T(free_kink_precision), order[o]));
+          }
+          points.push_back(point(l.position, order[o], T(offset > 0.0 ? 0. : free_kink_precision), (offset > 0.0 ? -1 : static_cast<int>(order[o]))));
+          continue;
+        }
+        T precision = T(0.);
+        if(value_of(l.material) > 0.0) {
+          T theta = highland*sqrt(l.material);
+          precision = 1./(theta*theta);
+        }
+        points.push_back(point(l.position, order[o], precision));
+        points.back().measurement = l.measurement;
+        if(l.measurement) points.back().weight = 1./(l.resolution*l.resolution);
+      }
+      std::stable_sort(points.begin(), points.end(), [](const point& a, const point& b) {
+          return value_of(a.position) < value_of(b.position);
+        });
+
+      // Kinks are only defined at inner points:
+      size_t nparameters = 2;
+      for(size_t p = 1; p + 1 < points.size(); p++) {
+        if(value_of(points[p].precision) > 0.0) points[p].kink = nparameters++;
+      }
+      m_parameters = nparameters;
+      m_positions.resize(points.size());
+      m_kinkOf.assign(points.size(), -1);
+      for(size_t p = 0; p < points.size(); p++) {
+        m_positions[p] = points[p].position;
+        m_kinkOf[p] = points[p].kink;
+        if(points[p].layer >= 0) m_label[points[p].layer] = p;
+        if(points[p].unknown >= 0 && points[p].kink >= 0) m_kinks[points[p].unknown].push_back(points[p].kink);
+      }
+
+      // Information matrix from kink priors and measurements:
+      Matrix information = Matrix::Zero(nparameters, nparameters);
+      for(size_t p = 0; p < points.size(); p++) {
+        if(points[p].kink >= 0) information(points[p].kink, points[p].kink) += points[p].precision;
+        if(!points[p].measurement) continue;
+        Vector h = derivatives(p);
+        information += points[p].weight*h*h.transpose();
+      }
+      m_decomposition.compute(information);
+      m_points = points;
+    }
+
+    // Point along the trajectory, ordered in z
+    struct point {
+      point(const T& position, int layer, const T& precision, int unknown = -1) :
+        position(position), layer(layer), unknown(unknown), precision(precision),
+        measurement(false), weight(0.), kink(-1) {}
+      T position;
+      // Layer labelled by this point, unknown scatterer this kink belongs to
+      int layer;
+      int unknown;
+      T precision;
+      bool measurement;
+      T weight;
+      // Index of the kink parameter, -1 without kink
+      int kink;
+    };
+
+    // Variance of the track position at the given layer (index in the input vector)
+    T getVariance(size_t l) const {
+      Vector h = derivatives(m_label.at(l));
+      return h.dot(m_decomposition.solve(h));
+    }
+
+    // Covariance of the track positions at two layers
+    T getCovariance(size_t a, size_t b) const {
+      Vector h = derivatives(m_label.at(b));
+      return derivatives(m_label.at(a)).dot(m_decomposition.solve(h));
+    }
+
+    // All points along the trajectory with their kink precision and measurement weight. Kinks
+    // are only fitted at inner points, those with a kink parameter index.
+    const std::vector<point>& getPoints() const { return m_points; }
+
+    // Variance of the total kink of the unknown scatterer at the given layer
+    T getKinkVariance(size_t l) const {
+      Vector e = Vector::Zero(m_parameters);
+      for(auto k : m_kinks.at(l)) e(k) = 1.;
+      return e.dot(m_decomposition.solve(e));
+    }
+
+  private:
+    // Derivatives of the track position at a point with respect to all parameters
+    Vector derivatives(size_t p) const {
+      Vector h = Vector::Zero(m_parameters);
+      h(0) = 1.;
+      h(1) = m_positions[p] - m_positions.front();
+      for(size_t q = 1; q < p; q++) {
+        if(m_kinkOf[q] >= 0) h(m_kinkOf[q]) = m_positions[p] - m_positions[q];
+      }
+      return h;
+    }
+
+    size_t m_parameters;
+    std::vector<point> m_points;
+    std::vector<T> m_positions;
+    std::vector<int> m_kinkOf;
+    std::vector<size_t> m_label;
+    std::vector<std::vector<int>> m_kinks;
+    Eigen::LDLT<Matrix> m_decomposition;
+  };
+
+}
+
+#endif /* TRACKMODEL_H */
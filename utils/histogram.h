@@ -0,0 +1,91 @@
+/**
+ * Simple histogram with fixed linear or logarithmic binning which can be filled in parts and merged
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+#include <vector>
+
+namespace gblsim {
+
+  class histogram {
+  public:
+    histogram(size_t bins = 100, double min = -1., double max = 1.) :
+      m_min(min), m_max(max), m_log(false), m_counts(bins, 0), m_underflow(0), m_overflow(0) {}
+
+    // Bins of equal width in log(x), for positive ranges only
+    static histogram logarithmic(size_t bins, double min, double max) {
+      histogram h(bins, std::log(min), std::log(max));
+      h.m_log = true;
+      return h;
+    }
+
+    void fill(double x) {
+      if(m_log) x = (x > 0. ? std::log(x) : -HUGE_VAL);
+      if(!(x >= m_min)) m_underflow++;
+      else if(x >= m_max) m_overflow++;
+      else m_counts[std::min(static_cast<size_t>((x - m_min)/(m_max - m_min)*m_counts.size()), m_counts.size() - 1)]++;
+    }
+
+    // Add the entries of a histogram with identical binning
+    void add(const histogram& other) {
+      for(size_t b = 0; b < m_counts.size() && b < other.m_counts.size(); b++) m_counts[b] += other.m_counts[b];
+      m_underflow += other.m_underflow;
+      m_overflow += other.m_overflow;
+    }
+
+    size_t bins() const { return m_counts.size(); }
+    double center(size_t bin) const {
+      double c = m_min + (bin + 0.5)*(m_max - m_min)/m_counts.size();
+      return (m_log ? std::exp(c) : c);
+    }
+    size_t content(size_t bin) const { return m_counts.at(bin); }
+    size_t underflow() const { return m_underflow; }
+    size_t overflow() const { return m_overflow; }
+    size_t entries() const {
+      size_t sum = m_underflow + m_overflow;
+      for(auto c : m_counts) sum += c;
+      return sum;
+    }
+
+    // Write bin centres and contents as two columns
+    void write(std::ostream& out) const {
+      out << "# underflow " << m_underflow << " overflow " << m_overflow << "\n";
+      for(size_t b = 0; b < m_counts.size(); b++) out << center(b) << " " << m_counts[b] << "\n";
+    }
+
+    // Exact state as numbers, e.g. for checkpoints, and its restoration
+    void save(std::vector<double>& state) const {
+      state.insert(state.end(), {m_min, m_max, m_log ? 1. : 0., static_cast<double>(m_counts.size()),
+            static_cast<double>(m_underflow), static_cast<double>(m_overflow)});
+      for(auto c : m_counts) state.push_back(static_cast<double>(c));
+    }
+    bool load(const double*& state, const double* end) {
+      if(end - state < 6 || static_cast<size_t>(end - state - 6) < static_cast<size_t>(state[3])) return false;
+      m_min = state[0];
+      m_max = state[1];
+      m_log = (state[2] != 0.);
+      m_counts.assign(static_cast<size_t>(state[3]), 0);
+      m_underflow = static_cast<size_t>(state[4]);
+      m_overflow = static_cast<size_t>(state[5]);
+      state += 6;
+      for(auto& c : m_counts) c = static_cast<size_t>(*state++);
+      return true;
+    }
+
+  private:
+    double m_min;
+    double m_max;
+    bool m_log;
+    std::vector<size_t> m_counts;
+    size_t m_underflow;
+    size_t m_overflow;
+  };
+
+}
+
+#endif /* HISTOGRAM_H */
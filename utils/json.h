@@ -0,0 +1,284 @@
+/**
+ * Minimal JSON values with parser and writer for line-delimited requests
+ */
+
+#ifndef JSON_H
+#define JSON_H
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace gblsim {
+
+  class json {
+  public:
+    enum kind { null_value, boolean_value, number_value, string_value, array_value, object_value };
+
+    json() : m_kind(null_value), m_number(0.) {}
+    json(bool value) : m_kind(boolean_value), m_number(value ? 1. : 0.) {}
+    json(double value) : m_kind(number_value), m_number(value) {}
+    json(int value) : m_kind(number_value), m_number(value) {}
+    json(size_t value) : m_kind(number_value), m_number(static_cast<double>(value)) {}
+    json(const std::string& value) : m_kind(string_value), m_number(0.), m_string(value) {}
+    json(const char* value) : m_kind(string_value), m_number(0.), m_string(value) {}
+    json(const std::vector<json>& values) : m_kind(array_value), m_number(0.), m_array(values) {}
+    static json object() { json j; j.m_kind = object_value; return j; }
+
+    kind type() const { return m_kind; }
+    bool isNull() const { return m_kind == null_value; }
+    bool isNumber() const { return m_kind == number_value; }
+    bool isString() const { return m_kind == string_value; }
+    bool isArray() const { return m_kind == array_value; }
+    bool isObject() const { return m_kind == object_value; }
+
+    double number() const { return m_number; }
+    bool boolean() const { return m_number != 0.; }
+    const std::string& string() const { return m_string; }
+    const std::vector<json>& array() const { return m_array; }
+    std::vector<json>& array() { return m_array; }
+
+    // Object members, a missing member is null
+    bool has(const std::string& key) const { return m_object.count(key) > 0; }
+    const json& operator[](const std::string& key) const {
+      static const json missing;
+      auto it = m_object.find(key);
+      return (it == m_object.end() ? missing : it->second);
+    }
+    json& set(const std::string& key, const json& value) {
+      m_kind = object_value;
+      m_object[key] = value;
+      return *this;
+    }
+
+    // Parse a complete document, returns false with a message for invalid input
+    static bool parse(const std::string& text, json& value, std::string& error) {
+      size_t pos = 0;
+      if(!parseValue(text, pos, value, error, 0)) return false;
+      skip(text, pos);
+      if(pos != text.size()) {
+        error = "unexpected characters after value";
+        return false;
+      }
+      return true;
+    }
+
+    // Compact single-line representation
+    std::string dump() const {
+      std::string out;
+      write(out);
+      return out;
+    }
+
+  private:
+    static void skip(const std::string& text, size_t& pos) {
+      while(pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r' || text[pos] == '\n')) pos++;
+    }
+
+    static bool parseString(const std::string& text, size_t& pos, std::string& out, std::string& error) {
+      pos++;
+      while(pos < text.size() && text[pos] != '"') {
+        char c = text[pos++];
+        if(c != '\\') {
+          out += c;
+          continue;
+        }
+        if(pos >= text.size()) break;
+        char e = text[pos++];
+        switch(e) {
+        case 'n': out += '\n'; break;
+        case 't': out += '\t'; break;
+        case 'r': out += '\r'; break;
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'u': {
+          // Only code points of the basic multilingual plane, written as UTF-8:
+          if(pos + 4 > text.size()) break;
+          unsigned long cp = std::strtoul(text.substr(pos, 4).c_str(), nullptr, 16);
+          pos += 4;
+          if(cp < 0x80) out += static_cast<char>(cp);
+          else if(cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+          }
+          else {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+          }
+          break;
+        }
+        default: out += e;
+        }
+      }
+      if(pos >= text.size()) {
+        error = "unterminated string";
+        return false;
+      }
+      pos++;
+      return true;
+    }
+
+    static bool parseValue(const std::string& text, size_t& pos, json& value, std::string& error, int depth) {
+      if(depth > 64) {
+        error = "nesting too deep";
+        return false;
+      }
+      skip(text, pos);
+      if(pos >= text.size()) {
+        error = "unexpected end of input";
+        return false;
+      }
+      char c = text[pos];
+      if(c == '{') {
+        value = object();
+        pos++;
+        skip(text, pos);
+        if(pos < text.size() && text[pos] == '}') {
+          pos++;
+          return true;
+        }
+        while(true) {
+          skip(text, pos);
+          std::string key;
+          if(pos >= text.size() || text[pos] != '"' || !parseString(text, pos, key, error)) {
+            if(error.empty()) error = "expected member name";
+            return false;
+          }
+          skip(text, pos);
+          if(pos >= text.size() || text[pos++] != ':') {
+            error = "expected ':'";
+            return false;
+          }
+          json member;
+          if(!parseValue(text, pos, member, error, depth + 1)) return false;
+          value.m_object[key] = member;
+          skip(text, pos);
+          if(pos < text.size() && text[pos] == ',') {
+            pos++;
+            continue;
+          }
+          if(pos < text.size() && text[pos] == '}') {
+            pos++;
+            return true;
+          }
+          error = "expected ',' or '}'";
+          return false;
+        }
+      }
+      if(c == '[') {
+        value = json(std::vector<json>());
+        pos++;
+        skip(text, pos);
+        if(pos < text.size() && text[pos] == ']') {
+          pos++;
+          return true;
+        }
+        while(true) {
+          json element;
+          if(!parseValue(text, pos, element, error, depth + 1)) return false;
+          value.m_array.push_back(element);
+          skip(text, pos);
+          if(pos < text.size() && text[pos] == ',') {
+            pos++;
+            continue;
+          }
+          if(pos < text.size() && text[pos] == ']') {
+            pos++;
+            return true;
+          }
+          error = "expected ',' or ']'";
+          return false;
+        }
+      }
+      if(c == '"') {
+        std::string s;
+        if(!parseString(text, pos, s, error)) return false;
+        value = json(s);
+        return true;
+      }
+      if(text.compare(pos, 4, "true") == 0) { pos += 4; value = json(true); return true; }
+      if(text.compare(pos, 5, "false") == 0) { pos += 5; value = json(false); return true; }
+      if(text.compare(pos, 4, "null") == 0) { pos += 4; value = json(); return true; }
+
+      const char* begin = text.c_str() + pos;
+      char* end = nullptr;
+      double number = std::strtod(begin, &end);
+      if(end == begin) {
+        error = "invalid value";
+        return false;
+      }
+      pos += end - begin;
+      value = json(number);
+      return true;
+    }
+
+    void write(std::string& out) const {
+      switch(m_kind) {
+      case null_value: out += "null"; break;
+      case boolean_value: out += (m_number != 0. ? "true" : "false"); break;
+      case number_value: {
+        // JSON has no representation for infinities and NaN:
+        if(!std::isfinite(m_number)) {
+          out += "null";
+          break;
+        }
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.17g", m_number);
+        out += buffer;
+        break;
+      }
+      case string_value: writeString(m_string, out); break;
+      case array_value:
+        out += '[';
+        for(size_t i = 0; i < m_array.size(); i++) {
+          if(i > 0) out += ',';
+          m_array[i].write(out);
+        }
+        out += ']';
+        break;
+      case object_value: {
+        out += '{';
+        bool first = true;
+        for(const auto& member : m_object) {
+          if(!first) out += ',';
+          first = false;
+          writeString(member.first, out);
+          out += ':';
+          member.second.write(out);
+        }
+        out += '}';
+        break;
+      }
+      }
+    }
+
+    static void writeString(const std::string& s, std::string& out) {
+      out += '"';
+      for(char c : s) {
+        if(c == '"' || c == '\\') { out += '\\'; out += c; }
+        else if(c == '\n') out += "\\n";
+        else if(c == '\t') out += "\\t";
+        else if(static_cast<unsigned char>(c) < 0x20) {
+          char buffer[8];
+          std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+          out += buffer;
+        }
+        else out += c;
+      }
+      out += '"';
+    }
+
+    kind m_kind;
+    double m_number;
+    std::string m_string;
+    std::vector<json> m_array;
+    std::map<std::string, json> m_object;
+  };
+
+}
+
+#endif /* JSON_H */
@@ -28,6 +28,14 @@ typedef unsigned int uint32_t;
 #include <iomanip>
 #include <cstdio>
 #include <string.h>
+#include <ctime>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 
 
 namespace unilog {
@@ -56,15 +64,43 @@ namespace unilog {
     static std::string ToString(TLogLevel level);
     static TLogLevel FromString(const std::string& level);
   protected:
-    std::ostringstream os;
+    std::ostringstream& os;
   private:
+    TLogLevel m_level;
     uniLog(const uniLog&);
     uniLog& operator =(const uniLog&);
     std::string NowTime();
+
+    // Message buffers of this thread, reused for all messages. Messages can be logged while
+    // another one is formatted (e.g. from a function called in the stream expression), so
+    // there is one buffer per nesting depth:
+    struct buffers {
+      buffers() : depth(0) {}
+      std::vector<std::unique_ptr<std::ostringstream>> streams;
+      size_t depth;
+    };
+    static buffers& Buffers();
+    static std::ostringstream& Acquire();
   };
 
   template <typename T>
-    uniLog<T>::uniLog() {}
+    typename uniLog<T>::buffers& uniLog<T>::Buffers() {
+    static thread_local buffers local;
+    return local;
+  }
+
+  template <typename T>
+    std::ostringstream& uniLog<T>::Acquire() {
+    buffers& local = Buffers();
+    if(local.depth == local.streams.size()) local.streams.emplace_back(new std::ostringstream());
+    std::ostringstream& stream = *local.streams[local.depth++];
+    stream.str(std::string());
+    stream.clear();
+    return stream;
+  }
+
+  template <typename T>
+    uniLog<T>::uniLog() : os(Acquire()), m_level(logINFO) {}
 
 
 #ifdef WIN32
@@ -87,13 +123,16 @@ namespace unilog {
 
   template <typename T>
     std::string uniLog<T>::NowTime() {
-    char buffer[11];
-    time_t t;
-    time(&t);
-    tm r = * localtime(&t);
-    strftime(buffer, sizeof(buffer), "%X", localtime_r(&t, &r));
+    // The local time is only converted once per second and thread:
+    static thread_local time_t last = 0;
+    static thread_local char buffer[11] = {0};
     struct timeval tv;
     gettimeofday(&tv, 0);
+    if(tv.tv_sec != last) {
+      last = tv.tv_sec;
+      tm r;
+      strftime(buffer, sizeof(buffer), "%X", localtime_r(&last, &r));
+    }
     char result[100] = {0};
     std::sprintf(result, "%s.%03ld", buffer, static_cast<long>(tv.tv_usec) / 1000); 
     return result;
@@ -103,6 +142,7 @@ namespace unilog {
 
   template <typename T>
     std::ostringstream& uniLog<T>::Get(TLogLevel level, std::string file, std::string function, uint32_t line) {
+    m_level = level;
     os << "[" << NowTime() << "] ";
     os << std::setw(8) << ToString(level) << ": ";
     
@@ -116,7 +156,8 @@ namespace unilog {
   template <typename T>
     uniLog<T>::~uniLog() {
     os << std::endl;
-    T::Output(os.str());
+    T::Output(os.str(), m_level <= logERROR);
+    Buffers().depth--;
   }
 
   template <typename T>
@@ -163,7 +204,92 @@ namespace unilog {
   public:
     static FILE*& Stream();
     static bool& Duplicate();
-    static void Output(const std::string& msg);
+    // Write messages from a background thread in batches instead of from the logging thread,
+    // for tools logging from parallel loops. Errors are always written immediately.
+    static bool& Asynchronous();
+    static void Output(const std::string& msg, bool immediate = false);
+    // Write all pending messages
+    static void Flush();
+  private:
+    static void Write(const std::string& msg);
+    class sink;
+    static sink& Sink();
+    static std::atomic<bool>& Stopped();
+  };
+
+  // Background writer collecting the messages of all threads. Every logging thread appends to its
+  // own queue, which the writer drains periodically, so logging threads never wait for each other.
+  // The sink is never destroyed: pending messages are written at exit, later ones directly.
+  class SetLogOutput::sink
+  {
+  public:
+    sink() : m_mutex(), m_queues(), m_write() {
+      std::atexit(&sink::shutdown);
+      std::thread(&sink::run, this).detach();
+    }
+
+    void push(const std::string& msg) {
+      queue& local = *Local();
+      {
+        std::lock_guard<std::mutex> lock(local.mutex);
+        local.pending += msg;
+      }
+      // The final drain at exit might already have passed this queue:
+      if(Stopped()) drain();
+    }
+
+    // Write the pending messages of all threads
+    void drain() {
+      std::lock_guard<std::mutex> write(m_write);
+      std::string batch;
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for(auto it = m_queues.begin(); it != m_queues.end();) {
+          {
+            std::lock_guard<std::mutex> local((*it)->mutex);
+            batch += (*it)->pending;
+            (*it)->pending.clear();
+          }
+          // Queues of finished threads are only referenced here:
+          if(it->use_count() == 1) it = m_queues.erase(it);
+          else ++it;
+        }
+      }
+      if(!batch.empty()) Write(batch);
+    }
+
+  private:
+    struct queue {
+      std::mutex mutex;
+      std::string pending;
+    };
+
+    // Queue of the calling thread, registered with the first message
+    std::shared_ptr<queue>& Local() {
+      static thread_local std::shared_ptr<queue> local;
+      if(!local) {
+        local = std::make_shared<queue>();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queues.push_back(local);
+      }
+      return local;
+    }
+
+    static void shutdown() {
+      Stopped() = true;
+      Sink().drain();
+    }
+
+    void run() {
+      while(!Stopped()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        drain();
+      }
+    }
+
+    std::mutex m_mutex;
+    std::vector<std::shared_ptr<queue>> m_queues;
+    std::mutex m_write;
   };
 
   inline bool& SetLogOutput::Duplicate()
@@ -178,28 +304,71 @@ namespace unilog {
     return pStream;
   }
 
-  inline void SetLogOutput::Output(const std::string& msg)
-  {   
+  inline bool& SetLogOutput::Asynchronous()
+  {
+    static bool async = false;
+    return async;
+  }
+
+  inline std::atomic<bool>& SetLogOutput::Stopped()
+  {
+    static std::atomic<bool> stopped(false);
+    return stopped;
+  }
+
+  inline SetLogOutput::sink& SetLogOutput::Sink()
+  {
+    // Intentionally leaked, threads may still log while static objects are destroyed:
+    static sink* writer = new sink();
+    return *writer;
+  }
+
+  inline void SetLogOutput::Write(const std::string& msg)
+  {
     FILE* pStream = Stream();
     if (!pStream)
       return;
     // Check if duplication to stderr is needed:
     if (Duplicate() && pStream != stderr)
-      fprintf(stderr, "%s", msg.c_str());
-    fprintf(pStream, "%s", msg.c_str());
+      fwrite(msg.data(), 1, msg.size(), stderr);
+    fwrite(msg.data(), 1, msg.size(), pStream);
     fflush(pStream);
   }
 
+  inline void SetLogOutput::Output(const std::string& msg, bool immediate)
+  {
+    if (!Asynchronous() || Stopped())
+      Write(msg);
+    else if (!immediate)
+      Sink().push(msg);
+    else {
+      // Keep the order with the messages logged before:
+      Sink().drain();
+      Write(msg);
+    }
+  }
+
+  inline void SetLogOutput::Flush()
+  {
+    if (Asynchronous() && !Stopped())
+      Sink().drain();
+  }
+
 typedef uniLog<SetLogOutput> Log;
 
 #define __FILE_NAME__ (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__)
 
+// Most verbose level compiled in, statements above it are removed by the compiler:
+#ifndef UNILOG_MAX_LEVEL
+#define UNILOG_MAX_LEVEL unilog::logDEBUG5
+#endif
+
 #define IFLOG(level)							\
-  if (level > unilog::Log::ReportingLevel() || !unilog::SetLogOutput::Stream()) ; \
+  if (level > UNILOG_MAX_LEVEL || level > unilog::Log::ReportingLevel() || !unilog::SetLogOutput::Stream()) ; \
   else 
 
 #define LOG(level)				\
-  if (level > unilog::Log::ReportingLevel() || !unilog::SetLogOutput::Stream()) ; \
+  if (level > UNILOG_MAX_LEVEL || level > unilog::Log::ReportingLevel() || !unilog::SetLogOutput::Stream()) ; \
   else unilog::Log().Get(level,__FILE_NAME__,__func__,__LINE__)
 
 } //namespace unilog
@@ -19,6 +19,9 @@
 // X0 air = 36.66/1.204E-3 = 303.9 m
 #define X0_Air 304200.0
 
+// X0 He = 94.32/1.663E-4 = 5671 m
+#define X0_He 5671000.0
+
 // X0 Kapton =  40.56 / 1.42 = 28.56 cm
 #define X0_Kapton  285.6
 
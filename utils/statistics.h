@@ -0,0 +1,341 @@
+/**
+ * Streaming statistics which can be filled in parts and merged
+ */
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace gblsim {
+
+  // Mean, variance, skewness and kurtosis with Welford's update. Merging uses the pairwise
+  // update of the central moments and gives the same result as filling all values into one.
+  class moments {
+  public:
+    moments() : m_n(0), m_mean(0.), m_m2(0.), m_m3(0.), m_m4(0.) {}
+
+    void fill(double x) {
+      moments single;
+      single.m_n = 1;
+      single.m_mean = x;
+      add(single);
+    }
+
+    void add(const moments& other) {
+      if(other.m_n == 0) return;
+      if(m_n == 0) {
+        *this = other;
+        return;
+      }
+      double na = m_n, nb = other.m_n, n = na + nb;
+      double delta = other.m_mean - m_mean;
+      double delta2 = delta*delta;
+      m_m4 += other.m_m4 + delta2*delta2*na*nb*(na*na - na*nb + nb*nb)/(n*n*n)
+        + 6.*delta2*(na*na*other.m_m2 + nb*nb*m_m2)/(n*n) + 4.*delta*(na*other.m_m3 - nb*m_m3)/n;
+      m_m3 += other.m_m3 + delta2*delta*na*nb*(na - nb)/(n*n) + 3.*delta*(na*other.m_m2 - nb*m_m2)/n;
+      m_m2 += other.m_m2 + delta2*na*nb/n;
+      m_mean += delta*nb/n;
+      m_n += other.m_n;
+    }
+
+    size_t entries() const { return m_n; }
+    double mean() const { return m_mean; }
+    // Unbiased variance and standard deviation
+    double variance() const { return (m_n > 1 ? m_m2/(m_n - 1) : 0.); }
+    double sigma() const { return std::sqrt(variance()); }
+    // Root mean square of the values, not of their deviations from the mean
+    double rms() const { return (m_n > 0 ? std::sqrt(m_m2/m_n + m_mean*m_mean) : 0.); }
+    double meanError() const { return (m_n > 0 ? sigma()/std::sqrt(m_n) : 0.); }
+    // Uncertainty of the standard deviation for Gaussian values
+    double sigmaError() const { return (m_n > 1 ? sigma()/std::sqrt(2.*(m_n - 1)) : 0.); }
+    double skewness() const { return (m_m2 > 0. ? std::sqrt(static_cast<double>(m_n))*m_m3/std::pow(m_m2, 1.5) : 0.); }
+    // Excess kurtosis, zero for a Gaussian
+    double kurtosis() const { return (m_m2 > 0. ? m_n*m_m4/(m_m2*m_m2) - 3. : 0.); }
+
+    // Exact state as numbers, e.g. for checkpoints, and its restoration
+    void save(std::vector<double>& state) const {
+      state.insert(state.end(), {static_cast<double>(m_n), m_mean, m_m2, m_m3, m_m4});
+    }
+    bool load(const double*& state, const double* end) {
+      if(end - state < 5) return false;
+      m_n = static_cast<size_t>(state[0]);
+      m_mean = state[1];
+      m_m2 = state[2];
+      m_m3 = state[3];
+      m_m4 = state[4];
+      state += 5;
+      return true;
+    }
+
+  private:
+    size_t m_n;
+    double m_mean;
+    double m_m2;
+    double m_m3;
+    double m_m4;
+  };
+
+  // Streaming quantiles with a merging t-digest.
+  //
+  // Values are buffered and regularly merged into centroids whose size is limited by the scale
+  // function k(q) = compression/(2 pi) asin(2q - 1), so that centroids near the tails stay small
+  // and extreme quantiles are accurate. Memory is bounded by the compression. Merged digests give
+  // the same accuracy guarantees as a single one, the quantiles themselves are approximate.
+  class tdigest {
+  public:
+    explicit tdigest(double compression = 200.) :
+      m_compression(compression), m_total(0.), m_min(std::numeric_limits<double>::infinity()),
+      m_max(-std::numeric_limits<double>::infinity()) {}
+
+    void fill(double x, double weight = 1.) {
+      m_buffer.push_back(centroid(x, weight));
+      m_min = std::min(m_min, x);
+      m_max = std::max(m_max, x);
+      if(m_buffer.size() >= 8*static_cast<size_t>(m_compression)) compress();
+    }
+
+    void add(const tdigest& other) {
+      m_buffer.insert(m_buffer.end(), other.m_centroids.begin(), other.m_centroids.end());
+      m_buffer.insert(m_buffer.end(), other.m_buffer.begin(), other.m_buffer.end());
+      m_min = std::min(m_min, other.m_min);
+      m_max = std::max(m_max, other.m_max);
+      compress();
+    }
+
+    double entries() const {
+      double sum = m_total;
+      for(const auto& c : m_buffer) sum += c.weight;
+      return sum;
+    }
+
+    // Value below which the given fraction of the entries lies
+    double quantile(double q) {
+      compress();
+      if(m_centroids.empty()) return std::numeric_limits<double>::quiet_NaN();
+      if(q <= 0.) return m_min;
+      if(q >= 1.) return m_max;
+
+      // Interpolate between centroid means, each centroid is centred on its cumulative weight:
+      double target = q*m_total;
+      double cumulative = 0.;
+      for(size_t c = 0; c < m_centroids.size(); c++) {
+        double centre = cumulative + 0.5*m_centroids[c].weight;
+        if(target < centre) {
+          double left = (c == 0 ? m_min : m_centroids[c-1].mean);
+          double left_centre = (c == 0 ? 0. : cumulative - 0.5*m_centroids[c-1].weight);
+          return left + (m_centroids[c].mean - left)*(target - left_centre)/(centre - left_centre);
+        }
+        cumulative += m_centroids[c].weight;
+      }
+      double centre = m_total - 0.5*m_centroids.back().weight;
+      return m_centroids.back().mean + (m_max - m_centroids.back().mean)*(target - centre)/(m_total - centre);
+    }
+
+    // Exact state including buffered values, so a restored digest continues identically
+    void save(std::vector<double>& state) const {
+      state.insert(state.end(), {m_compression, m_total, m_min, m_max,
+            static_cast<double>(m_centroids.size()), static_cast<double>(m_buffer.size())});
+      for(const auto& c : m_centroids) state.insert(state.end(), {c.mean, c.weight});
+      for(const auto& c : m_buffer) state.insert(state.end(), {c.mean, c.weight});
+    }
+    bool load(const double*& state, const double* end) {
+      if(end - state < 6) return false;
+      size_t centroids = static_cast<size_t>(state[4]), buffered = static_cast<size_t>(state[5]);
+      if(static_cast<size_t>(end - state - 6) < 2*(centroids + buffered)) return false;
+      m_compression = state[0];
+      m_total = state[1];
+      m_min = state[2];
+      m_max = state[3];
+      state += 6;
+      m_centroids.clear();
+      m_buffer.clear();
+      for(size_t c = 0; c < centroids; c++, state += 2) m_centroids.push_back(centroid(state[0], state[1]));
+      for(size_t c = 0; c < buffered; c++, state += 2) m_buffer.push_back(centroid(state[0], state[1]));
+      return true;
+    }
+
+  private:
+    struct centroid {
+      centroid(double mean, double weight) : mean(mean), weight(weight) {}
+      double mean;
+      double weight;
+    };
+
+    double scale(double q) const { return m_compression/(2.*M_PI)*std::asin(2.*std::min(1., std::max(0., q)) - 1.); }
+
+    void compress() {
+      if(m_buffer.empty()) return;
+      m_buffer.insert(m_buffer.end(), m_centroids.begin(), m_centroids.end());
+      std::sort(m_buffer.begin(), m_buffer.end(), [](const centroid& a, const centroid& b) { return a.mean < b.mean; });
+
+      double total = 0.;
+      for(const auto& c : m_buffer) total += c.weight;
+      m_centroids.clear();
+      double cumulative = 0.;
+      double limit = scale(0.) + 1.;
+      centroid current = m_buffer.front();
+      for(size_t b = 1; b < m_buffer.size(); b++) {
+        const centroid& next = m_buffer[b];
+        // Merge while the centroid spans less than one unit of the scale function:
+        if(scale((cumulative + current.weight + next.weight)/total) <= limit) {
+          current.mean += (next.mean - current.mean)*next.weight/(current.weight + next.weight);
+          current.weight += next.weight;
+        }
+        else {
+          cumulative += current.weight;
+          m_centroids.push_back(current);
+          limit = scale(cumulative/total) + 1.;
+          current = next;
+        }
+      }
+      m_centroids.push_back(current);
+      m_total = total;
+      m_buffer.clear();
+    }
+
+    double m_compression;
+    double m_total;
+    double m_min;
+    double m_max;
+    std::vector<centroid> m_centroids;
+    std::vector<centroid> m_buffer;
+  };
+
+  // Unbinned maximum likelihood fit of a Gaussian to the values within a window.
+  //
+  // Only the number of values and the moments within the window are accumulated, which are the
+  // sufficient statistics of a Gaussian truncated to the window, so filling is streaming and
+  // merging is exact. The fit matches the first two moments of the truncated Gaussian to the
+  // data, which is the maximum likelihood solution, and does not depend on any binning.
+  class gaussfit {
+  public:
+    gaussfit(double min = -std::numeric_limits<double>::infinity(), double max = std::numeric_limits<double>::infinity()) :
+      m_min(min), m_max(max) {}
+
+    void fill(double x) { if(x >= m_min && x <= m_max) m_moments.fill(x); }
+    void add(const gaussfit& other) { m_moments.add(other.m_moments); }
+    size_t entries() const { return m_moments.entries(); }
+
+    void save(std::vector<double>& state) const {
+      state.insert(state.end(), {m_min, m_max});
+      m_moments.save(state);
+    }
+    bool load(const double*& state, const double* end) {
+      if(end - state < 2) return false;
+      m_min = state[0];
+      m_max = state[1];
+      state += 2;
+      return m_moments.load(state, end);
+    }
+
+    struct result {
+      double mean;
+      double sigma;
+      double mean_error;
+      double sigma_error;
+      bool converged;
+    };
+
+    result fit() const {
+      result r;
+      size_t n = m_moments.entries();
+      double m1 = m_moments.mean();
+      double var = (n > 0 ? m_moments.variance()*(n - 1)/n : 0.);
+      r.mean = m1;
+      r.sigma = std::sqrt(var);
+      r.mean_error = m_moments.meanError();
+      r.sigma_error = m_moments.sigmaError();
+      r.converged = (n > 1 && var > 0.);
+      if(!r.converged || (std::isinf(m_min) && std::isinf(m_max))) return r;
+
+      // Newton iterations on the mean and variance of the truncated Gaussian:
+      r.converged = false;
+      double mu = m1, sigma = r.sigma;
+      double J[2][2];
+      for(int iteration = 0; iteration < 50; iteration++) {
+        double t[4];
+        truncated(mu, sigma, t);
+        double f0 = t[0] - m1, f1 = t[1] - var;
+        if(std::fabs(f0) < 1e-10*sigma && std::fabs(f1) < 1e-10*var) {
+          r.converged = true;
+          break;
+        }
+        jacobian(mu, sigma, J);
+        double det = J[0][0]*J[1][1] - J[0][1]*J[1][0];
+        if(det == 0.) break;
+        double dmu = (J[1][1]*f0 - J[0][1]*f1)/det;
+        double dsigma = (J[0][0]*f1 - J[1][0]*f0)/det;
+        mu -= dmu;
+        // Keep the width positive:
+        sigma = (sigma - dsigma > 0.1*sigma ? sigma - dsigma : 0.1*sigma);
+      }
+      r.mean = mu;
+      r.sigma = sigma;
+
+      // Uncertainties from the covariance of sample mean and variance, propagated through the
+      // inverse Jacobian of the moment equations:
+      double t[4];
+      truncated(mu, sigma, t);
+      double cov_data[2][2] = {{t[1]/n, t[2]/n}, {t[2]/n, (t[3] - t[1]*t[1])/n}};
+      jacobian(mu, sigma, J);
+      double det = J[0][0]*J[1][1] - J[0][1]*J[1][0];
+      double inv[2][2] = {{J[1][1]/det, -J[0][1]/det}, {-J[1][0]/det, J[0][0]/det}};
+      double cov[2][2];
+      for(int i = 0; i < 2; i++) {
+        for(int j = 0; j < 2; j++) {
+          cov[i][j] = 0.;
+          for(int k = 0; k < 2; k++) for(int l = 0; l < 2; l++) cov[i][j] += inv[i][k]*cov_data[k][l]*inv[j][l];
+        }
+      }
+      r.mean_error = std::sqrt(cov[0][0]);
+      r.sigma_error = std::sqrt(cov[1][1]);
+      return r;
+    }
+
+  private:
+    // Mean and second to fourth central moments of the Gaussian truncated to the window
+    void truncated(double mu, double sigma, double t[4]) const {
+      double a = std::max(m_min, mu - 12.*sigma) - mu, b = std::min(m_max, mu + 12.*sigma) - mu;
+      const int steps = 400;
+      double h = (b - a)/steps;
+      double sum[5] = {0., 0., 0., 0., 0.};
+      // Simpson's rule in the distance to mu:
+      for(int s = 0; s <= steps; s++) {
+        double y = a + s*h;
+        double w = (s == 0 || s == steps ? 1. : (s % 2 ? 4. : 2.))*std::exp(-0.5*y*y/(sigma*sigma));
+        double p = 1.;
+        for(int k = 0; k < 5; k++, p *= y) sum[k] += w*p;
+      }
+      double e1 = sum[1]/sum[0], e2 = sum[2]/sum[0], e3 = sum[3]/sum[0], e4 = sum[4]/sum[0];
+      t[0] = mu + e1;
+      t[1] = e2 - e1*e1;
+      t[2] = e3 - 3.*e1*e2 + 2.*e1*e1*e1;
+      t[3] = e4 - 4.*e1*e3 + 6.*e1*e1*e2 - 3.*e1*e1*e1*e1;
+    }
+
+    // Derivatives of mean and variance of the truncated Gaussian by mu and sigma
+    void jacobian(double mu, double sigma, double J[2][2]) const {
+      double h = 1e-4*sigma;
+      double p[4], m[4];
+      truncated(mu + h, sigma, p);
+      truncated(mu - h, sigma, m);
+      J[0][0] = (p[0] - m[0])/(2*h);
+      J[1][0] = (p[1] - m[1])/(2*h);
+      truncated(mu, sigma + h, p);
+      truncated(mu, sigma - h, m);
+      J[0][1] = (p[0] - m[0])/(2*h);
+      J[1][1] = (p[1] - m[1])/(2*h);
+    }
+
+    double m_min;
+    double m_max;
+    moments m_moments;
+  };
+
+}
+
+#endif /* STATISTICS_H */
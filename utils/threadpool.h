@@ -0,0 +1,139 @@
+/**
+ * Simple thread pool with a parallel loop
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace gblsim {
+
+  class threadpool {
+  public:
+    // Start the given number of worker threads, zero selects one per hardware thread
+    explicit threadpool(unsigned int threads = 0) : m_stop(false) {
+      if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+      for(unsigned int i = 0; i < threads; i++) {
+        m_workers.emplace_back([this] { work(); });
+      }
+    }
+
+    ~threadpool() {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+      }
+      m_condition.notify_all();
+      for(auto& worker : m_workers) worker.join();
+    }
+
+    // Pool shared by all parts of the library which do not bring their own
+    static threadpool& global() {
+      static threadpool pool;
+      return pool;
+    }
+
+    unsigned int size() const { return m_workers.size(); }
+
+    // Queue a task, the returned future becomes ready once it has been executed
+    std::future<void> submit(std::function<void()> task) {
+      auto packaged = std::make_shared<std::packaged_task<void()>>(task);
+      std::future<void> result = packaged->get_future();
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push([packaged] { (*packaged)(); });
+      }
+      m_condition.notify_one();
+      return result;
+    }
+
+    // Call body(i) for all i in [0,n) and wait for completion. The calling thread takes part in the
+    // work and only waits for indices which are being processed, so loops may be nested. If the
+    // body throws, the remaining indices are skipped and the first exception is rethrown here once
+    // all indices are done.
+    void parallel_for(size_t n, const std::function<void(size_t)>& body) {
+      if(n == 0) return;
+
+      struct loop {
+        std::atomic<size_t> next;
+        std::atomic<bool> failed;
+        size_t done;
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable finished;
+      };
+      auto state = std::make_shared<loop>();
+      state->next = 0;
+      state->failed = false;
+      state->done = 0;
+
+      // Helpers only hold a reference to the body while indices remain to be claimed:
+      auto run = [state, n](const std::function<void(size_t)>& fn) {
+        size_t count = 0;
+        for(size_t i = state->next++; i < n; i = state->next++) {
+          // Failed indices count as done, the pool task would swallow the exception:
+          if(!state->failed) {
+            try {
+              fn(i);
+            }
+            catch(...) {
+              std::lock_guard<std::mutex> lock(state->mutex);
+              if(!state->error) state->error = std::current_exception();
+              state->failed = true;
+            }
+          }
+          count++;
+        }
+        if(count == 0) return;
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->done += count;
+        if(state->done == n) state->finished.notify_all();
+      };
+
+      const std::function<void(size_t)>* fn = &body;
+      size_t helpers = std::min<size_t>(size(), n - 1);
+      for(size_t h = 0; h < helpers; h++) {
+        submit([run, fn, state, n] { if(state->next < n) run(*fn); });
+      }
+      run(body);
+
+      std::unique_lock<std::mutex> lock(state->mutex);
+      state->finished.wait(lock, [&state, n] { return state->done == n; });
+      if(state->error) std::rethrow_exception(state->error);
+    }
+
+  private:
+    void work() {
+      while(true) {
+        std::function<void()> task;
+        {
+          std::unique_lock<std::mutex> lock(m_mutex);
+          m_condition.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+          if(m_stop && m_tasks.empty()) return;
+          task = std::move(m_tasks.front());
+          m_tasks.pop();
+        }
+        task();
+      }
+    }
+
+    std::vector<std::thread> m_workers;
+    std::queue<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stop;
+  };
+
+}
+
+#endif /* THREADPOOL_H */